@@ -0,0 +1,107 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "ArchiveExecutor.h"
+#include "MappedFile.h"
+#include <sstream>
+#include <stdexcept>
+
+ArchiveExecutor::ArchiveExecutor(unsigned threads)
+    : m_pool(threads)
+{}
+
+void ArchiveExecutor::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending++;
+    }
+    m_pool.post([this, task = std::move(task)]() {
+        // Only the handler can throw here; the request itself reports its
+        // errors to the handler.
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (error && !m_handler_error) {
+            m_handler_error = error;
+        }
+        if (--m_pending == 0) {
+            m_idle.notify_all();
+        }
+    });
+}
+
+void ArchiveExecutor::wait() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_pending == 0; });
+    if (m_handler_error) {
+        std::exception_ptr error = m_handler_error;
+        m_handler_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ArchiveExecutor::open(const std::filesystem::path& apath, OpenHandler handler, uint64_t base_offset) {
+    submit([apath, base_offset, handler = std::move(handler)]() {
+        Archive archive;
+        std::exception_ptr error;
+        try {
+            archive = std::make_shared<ISArchiveV3>(std::make_shared<const MappedFile>(apath), base_offset);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        handler(std::move(archive), error);
+    });
+}
+
+void ArchiveExecutor::decompress(Archive archive, const ISArchiveV3::File& file, DataHandler handler) {
+    submit([archive = std::move(archive), &file, handler = std::move(handler)]() {
+        std::vector<uint8_t> data;
+        std::exception_ptr error;
+        try {
+            std::vector<uint8_t> input;
+            archive->decompress(file, data, input);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        handler(std::move(data), error);
+    });
+}
+
+void ArchiveExecutor::decompress(Archive archive, std::string full_path, DataHandler handler) {
+    submit([archive = std::move(archive), full_path = std::move(full_path),
+            handler = std::move(handler)]() {
+        std::vector<uint8_t> data;
+        std::exception_ptr error;
+        try {
+            const ISArchiveV3::File* file = archive->file(full_path);
+            if (file == nullptr) {
+                std::ostringstream os;
+                os << "decompress() called with invalid path: " << full_path;
+                throw std::runtime_error(os.str());
+            }
+            std::vector<uint8_t> input;
+            archive->decompress(*file, data, input);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        handler(std::move(data), error);
+    });
+}
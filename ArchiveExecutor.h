@@ -0,0 +1,80 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "ISArchiveV3.h"
+#include "ThreadPool.h"
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Asynchronous archive access for callers that must not block, such as an
+// event loop. Requests return at once and run on a fixed number of worker
+// threads; any number may be in flight. Each completes by calling its
+// handler on a worker thread with either a result or the exception the
+// blocking call would have thrown. Handlers should pass results back to the
+// loop thread (e.g. through its wakeup pipe) instead of touching loop state
+// themselves. An exception escaping a handler does not stop the worker; the
+// first one is rethrown by wait().
+//
+// The destructor completes all requests already submitted.
+class ArchiveExecutor {
+public:
+    explicit ArchiveExecutor(unsigned threads);
+
+    using Archive = std::shared_ptr<ISArchiveV3>;
+    using OpenHandler = std::function<void(Archive archive, std::exception_ptr error)>;
+    using DataHandler = std::function<void(std::vector<uint8_t> data, std::exception_ptr error)>;
+
+    // Map and parse an archive. Entries of the result may be decompressed
+    // by concurrent requests.
+    void open(const std::filesystem::path& apath, OpenHandler handler, uint64_t base_offset = 0);
+    // Decompress an entry of an archive returned by open(). The request
+    // keeps the archive alive.
+    void decompress(Archive archive, const ISArchiveV3::File& file, DataHandler handler);
+    void decompress(Archive archive, std::string full_path, DataHandler handler);
+
+    // Block until all submitted requests, including those submitted by
+    // handlers meanwhile, have completed. Rethrows the first exception that
+    // escaped a handler since the last wait(). Must not be called from a
+    // handler.
+    void wait();
+
+    // Requests submitted and not yet completed, for callers that bound
+    // their backlog.
+    size_t pending() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_pending;
+    }
+    size_t threads() const {
+        return m_pool.size();
+    }
+
+protected:
+    void submit(std::function<void()> task);
+
+    mutable std::mutex m_mutex; // guards the members below
+    std::condition_variable m_idle;
+    size_t m_pending = 0;
+    std::exception_ptr m_handler_error;
+    ThreadPool m_pool; // last: drained while the members above still exist
+};
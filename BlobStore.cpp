@@ -0,0 +1,121 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "BlobStore.h"
+#include "Sha256.h"
+#include <cstdio>
+#include <sstream>
+#include <random>
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+static bool reflinkFile(const fs::path& src, const fs::path& dest) {
+#if defined(__linux__) && defined(FICLONE)
+    int in = ::open(src.c_str(), O_RDONLY);
+    if (in < 0) {
+        return false;
+    }
+    int out = ::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        ::close(in);
+        return false;
+    }
+    bool ok = ioctl(out, FICLONE, in) == 0;
+    ::close(in);
+    ::close(out);
+    if (!ok) {
+        std::error_code ec;
+        fs::remove(dest, ec);
+    }
+    return ok;
+#else
+    (void)src;
+    (void)dest;
+    return false;
+#endif
+}
+
+void linkFile(const fs::path& src, const fs::path& dest, LinkMode mode) {
+    std::error_code ec;
+    if (fs::equivalent(src, dest, ec)) {
+        return;
+    }
+    fs::remove(dest, ec);
+    if (mode == LinkMode::HARDLINK) {
+        fs::create_hard_link(src, dest, ec);
+        if (!ec) {
+            return;
+        }
+    } else if (mode == LinkMode::REFLINK) {
+        if (reflinkFile(src, dest)) {
+            return;
+        }
+    }
+    fs::copy_file(src, dest, fs::copy_options::overwrite_existing);
+}
+
+BlobStore::BlobStore(const std::filesystem::path& root, LinkMode mode)
+    : m_root(root), m_mode(mode)
+{
+    fs::create_directories(m_root);
+}
+
+std::string BlobStore::key(const std::vector<uint8_t>& compressed,
+        uint32_t uncompressed_size, bool uncompressed)
+{
+    std::ostringstream os;
+    os << Sha256::hex(compressed.data(), compressed.size())
+        << "-" << compressed.size() << "-" << uncompressed_size;
+    if (uncompressed) {
+        os << "-u";
+    }
+    return os.str();
+}
+
+fs::path BlobStore::blobPath(const std::string& key) const {
+    return m_root / key.substr(0, 2) / key;
+}
+
+bool BlobStore::fetch(const std::string& key, const fs::path& dest) const {
+    fs::path blob = blobPath(key);
+    if (!fs::exists(blob)) {
+        return false;
+    }
+    linkFile(blob, dest, m_mode == LinkMode::COPY ? LinkMode::COPY : LinkMode::REFLINK);
+    return true;
+}
+
+void BlobStore::put(const std::string& key, const fs::path& src) const {
+    fs::path blob = blobPath(key);
+    if (fs::exists(blob)) {
+        return;
+    }
+    fs::create_directories(blob.parent_path());
+    // Link under a private name first and rename, so that concurrent runs
+    // never see a partial blob.
+    std::ostringstream tmp_name;
+    tmp_name << key << ".tmp" << std::hex << std::random_device()();
+    fs::path tmp = blob.parent_path() / tmp_name.str();
+    linkFile(src, tmp, m_mode == LinkMode::HARDLINK ? LinkMode::COPY : m_mode);
+    fs::rename(tmp, blob);
+}
@@ -0,0 +1,61 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// How a file that is already on disk is materialized at another path.
+enum class LinkMode {
+    HARDLINK,   // share the inode
+    REFLINK,    // copy-on-write clone (Btrfs, XFS, ...)
+    COPY
+};
+
+// Make `dest` a copy of `src` using `mode`, falling back to a plain copy when
+// the file system cannot link. An existing `dest` is replaced, unless it is
+// `src` itself.
+void linkFile(const std::filesystem::path& src, const std::filesystem::path& dest, LinkMode mode);
+
+// Content-addressed store of extracted files, shared between runs.
+//
+// Blobs are keyed by the SHA-256 of an entry's stored bytes and its sizes, so
+// a file that was decompressed once from any archive can be linked into place
+// again without decoding it, and no archive can plant content under another
+// entry's key. Blobs never share an inode with an extracted file: they are
+// copied in, and fetched as reflinks or copies even with HARDLINK, so that
+// rewriting an extracted file cannot change the store.
+class BlobStore {
+public:
+    BlobStore(const std::filesystem::path& root, LinkMode mode);
+
+    static std::string key(const std::vector<uint8_t>& compressed,
+            uint32_t uncompressed_size, bool uncompressed);
+
+    // Copy or reflink blob `key` to `dest`. Returns false if it is not stored.
+    bool fetch(const std::string& key, const std::filesystem::path& dest) const;
+    // Add `src` under `key`, unless another writer got there first.
+    void put(const std::string& key, const std::filesystem::path& src) const;
+
+protected:
+    std::filesystem::path blobPath(const std::string& key) const;
+
+    const std::filesystem::path m_root;
+    const LinkMode m_mode;
+};
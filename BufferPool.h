@@ -0,0 +1,129 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Reusable byte buffers for one thread, in power-of-two size classes from
+// 4 KB up. A buffer keeps its capacity and goes back to the pool when its
+// handle is destroyed, so extracting many entries of similar sizes stops
+// allocating after the first few. Not thread-safe: use one pool per worker.
+class BufferPool {
+public:
+    // Buffers are kept for reuse while their total capacity stays below
+    // `max_cached` bytes, and freed otherwise.
+    explicit BufferPool(uint64_t max_cached = 64 << 20)
+        : m_max_cached(max_cached)
+    {}
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    // Handle of a pooled buffer.
+    class Buffer {
+    public:
+        Buffer(BufferPool* pool, std::vector<uint8_t>&& data)
+            : m_pool(pool), m_data(std::move(data))
+        {}
+        Buffer(Buffer&& other)
+            : m_pool(other.m_pool), m_data(std::move(other.m_data))
+        {
+            other.m_pool = nullptr;
+        }
+        Buffer& operator=(Buffer&&) = delete;
+        ~Buffer() {
+            if (m_pool) {
+                m_pool->release(std::move(m_data));
+            }
+        }
+
+        std::vector<uint8_t>& operator*() {
+            return m_data;
+        }
+        std::vector<uint8_t>* operator->() {
+            return &m_data;
+        }
+
+    private:
+        BufferPool* m_pool;
+        std::vector<uint8_t> m_data;
+    };
+
+    // An empty buffer with room for at least `size` bytes.
+    Buffer get(size_t size) {
+        size_t c = sizeClass(size);
+        for (size_t k = c; k < m_free.size() && k <= c + 1; k++) {
+            if (!m_free[k].empty()) {
+                std::vector<uint8_t> v = std::move(m_free[k].back());
+                m_free[k].pop_back();
+                m_cached -= v.capacity();
+                return Buffer(this, std::move(v));
+            }
+        }
+        std::vector<uint8_t> v;
+        v.reserve(size_t(MIN_SIZE) << c);
+        m_allocations++;
+        return Buffer(this, std::move(v));
+    }
+
+    // Capacity of the buffers get(size) hands out.
+    static size_t capacityFor(size_t size) {
+        return MIN_SIZE << sizeClass(size);
+    }
+
+    // Buffers allocated because none could be reused.
+    uint64_t allocations() const {
+        return m_allocations;
+    }
+
+private:
+    static constexpr size_t MIN_SIZE = 4096;
+
+    // Smallest class whose buffers hold `size` bytes.
+    static size_t sizeClass(size_t size) {
+        size_t c = 0;
+        while ((MIN_SIZE << c) < size) {
+            c++;
+        }
+        return c;
+    }
+
+    void release(std::vector<uint8_t>&& v) {
+        size_t capacity = v.capacity();
+        if (capacity < MIN_SIZE || m_cached + capacity > m_max_cached) {
+            return;
+        }
+        // largest class the buffer can serve
+        size_t c = sizeClass(capacity);
+        if ((MIN_SIZE << c) > capacity) {
+            c--;
+        }
+        if (m_free.size() <= c) {
+            m_free.resize(c + 1);
+        }
+        v.clear();
+        m_free[c].push_back(std::move(v));
+        m_cached += capacity;
+    }
+
+    std::vector<std::vector<std::vector<uint8_t>>> m_free; // by size class
+    uint64_t m_cached = 0;
+    uint64_t m_max_cached;
+    uint64_t m_allocations = 0;
+};
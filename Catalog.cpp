@@ -0,0 +1,356 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Catalog.h"
+#include "Hash.h"
+#include "ISArchiveV3.h"
+#include "MappedTable.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+static const char CATALOG_MAGIC[8] = {'U', 'V', '3', 'C', 'A', 'T', 0, 0};
+
+Catalog::Catalog(const std::filesystem::path& apath)
+    : m_file(apath)
+{
+    const uint8_t* base = m_file.data();
+    uint64_t size = m_file.size();
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Catalog truncated");
+    }
+    m_header = reinterpret_cast<const Header*>(base);
+    if (memcmp(m_header->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0) {
+        throw std::runtime_error("Not a catalog file");
+    }
+    if (m_header->version != VERSION) {
+        throw std::runtime_error("Unsupported catalog version");
+    }
+    if (!tableFits(size, m_header->archives_offset, m_header->archive_count, sizeof(Archive))
+            || !tableFits(size, m_header->entries_offset, m_header->entry_count, sizeof(Entry))
+            || !tableFits(size, m_header->buckets_offset, m_header->bucket_count, sizeof(uint32_t))
+            || !tableFits(size, m_header->strings_offset, m_header->strings_size, 1)
+            || m_header->bucket_count == 0
+            || (m_header->bucket_count & (m_header->bucket_count - 1)) != 0) {
+        throw std::runtime_error("Catalog corrupt");
+    }
+    m_archives = reinterpret_cast<const Archive*>(base + m_header->archives_offset);
+    m_entries = reinterpret_cast<const Entry*>(base + m_header->entries_offset);
+    m_buckets = reinterpret_cast<const uint32_t*>(base + m_header->buckets_offset);
+    m_strings = reinterpret_cast<const char*>(base + m_header->strings_offset);
+    // The accessors hand out views and indices without further checks.
+    auto string_fits = [this](uint64_t offset, uint32_t length) {
+        return tableFits(m_header->strings_size, offset, length, 1);
+    };
+    for (uint32_t i = 0; i < m_header->archive_count; i++) {
+        const Archive& a = m_archives[i];
+        if (!string_fits(a.path_offset, a.path_length)
+                || a.first_entry > m_header->entry_count
+                || a.entry_count > m_header->entry_count - a.first_entry) {
+            throw std::runtime_error("Catalog corrupt");
+        }
+    }
+    for (uint32_t i = 0; i < m_header->entry_count; i++) {
+        const Entry& e = m_entries[i];
+        if (!string_fits(e.path_offset, e.path_length)
+                || e.name_length > e.path_length
+                || e.archive >= m_header->archive_count
+                || (e.next != NONE && e.next >= m_header->entry_count)) {
+            throw std::runtime_error("Catalog corrupt");
+        }
+    }
+}
+
+static bool equalsNoCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); i++) {
+        if (toupper(uint8_t(a[i])) != toupper(uint8_t(b[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<const Catalog::Entry*> Catalog::find(std::string_view name) const {
+    std::string query(name);
+    std::replace(query.begin(), query.end(), '/', '\\');
+    size_t sep = query.rfind('\\');
+    bool full_path = sep != std::string::npos;
+    std::string_view basename = full_path
+        ? std::string_view(query).substr(sep + 1) : std::string_view(query);
+
+    std::vector<const Entry*> hits;
+    uint32_t bucket = uint32_t(fnv1a64_nocase(basename)) & (m_header->bucket_count - 1);
+    ChainGuard guard(m_header->entry_count, "Catalog corrupt");
+    for (uint32_t i = m_buckets[bucket]; i != NONE && i < m_header->entry_count; i = m_entries[i].next) {
+        guard.step();
+        const Entry& e = m_entries[i];
+        std::string_view path = entryPath(e);
+        if (full_path) {
+            if (!equalsNoCase(path, query)) {
+                continue;
+            }
+        } else if (!equalsNoCase(path.substr(path.size() - e.name_length), basename)) {
+            continue;
+        }
+        hits.push_back(&e);
+    }
+    // Chains are built back to front; report in catalog order.
+    std::reverse(hits.begin(), hits.end());
+    return hits;
+}
+
+/**********************************************************************
+ * Building
+ **********************************************************************/
+namespace {
+
+class ScannedEntry {
+public:
+    std::string path;
+    uint8_t name_length;
+    uint32_t offset;
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t datetime;
+    uint8_t attrib;
+};
+
+class ScannedArchive {
+public:
+    std::string path;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    bool ok = false;
+    bool reused = false;
+    std::string error;
+    std::vector<ScannedEntry> entries;
+};
+
+// Cheap pre-check so that unrelated files in a scanned tree are skipped
+// without a diagnostic.
+bool hasArchiveSignature(const fs::path& apath, uint64_t file_size) {
+    std::ifstream fin(apath, std::ios::in | std::ios::binary);
+    ISArchiveV3::Header hdr;
+    if (!fin.read(reinterpret_cast<char*>(&hdr), sizeof(hdr))) {
+        return false;
+    }
+    return ISArchiveV3::isValidHeader(hdr, file_size);
+}
+
+void scanArchive(ScannedArchive& out, const Catalog* previous,
+        const std::unordered_map<std::string_view, uint32_t>& previous_index) {
+    std::error_code ec;
+    out.size = fs::file_size(out.path, ec);
+    if (ec) {
+        out.error = ec.message();
+        return;
+    }
+    out.mtime = int64_t(fs::last_write_time(out.path, ec).time_since_epoch().count());
+    if (ec) {
+        out.error = ec.message();
+        return;
+    }
+
+    if (previous) {
+        auto it = previous_index.find(out.path);
+        if (it != previous_index.end()) {
+            const Catalog::Archive& pa = previous->archive(it->second);
+            if (pa.size == out.size && pa.mtime == out.mtime) {
+                out.entries.reserve(pa.entry_count);
+                for (uint32_t i = 0; i < pa.entry_count; i++) {
+                    const Catalog::Entry& e = previous->entry(pa.first_entry + i);
+                    out.entries.push_back({std::string(previous->entryPath(e)), e.name_length,
+                            e.offset, e.compressed_size, e.uncompressed_size, e.datetime, e.attrib});
+                }
+                out.ok = true;
+                out.reused = true;
+                return;
+            }
+        }
+    }
+
+    if (!hasArchiveSignature(out.path, out.size)) {
+        return;
+    }
+    try {
+        ISArchiveV3 archive(out.path);
+        out.entries.reserve(archive.files().size());
+        for (const auto& f : archive.files()) {
+            out.entries.push_back({std::string(f.fullPath()), uint8_t(f.name().size()), f.offset,
+                    f.compressed_size, f.uncompressed_size, f.datetime, f.attrib});
+        }
+        out.ok = true;
+    } catch (const std::exception& e) {
+        out.error = e.what();
+    }
+}
+
+} // namespace
+
+template<class T> static void writeAt(std::ofstream& fout, uint64_t offset, const std::vector<T>& items) {
+    fout.seekp(std::streamoff(offset), std::ios::beg);
+    fout.write(reinterpret_cast<const char*>(items.data()), std::streamsize(items.size() * sizeof(T)));
+}
+
+static uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+Catalog::BuildResult Catalog::build(const std::filesystem::path& apath,
+        const std::vector<std::filesystem::path>& archives,
+        unsigned jobs, std::ostream& log)
+{
+    std::unique_ptr<Catalog> previous;
+    std::unordered_map<std::string_view, uint32_t> previous_index;
+    if (fs::exists(apath)) {
+        try {
+            previous = std::make_unique<Catalog>(apath);
+            for (uint32_t i = 0; i < previous->header().archive_count; i++) {
+                previous_index[previous->archivePath(previous->archive(i))] = i;
+            }
+        } catch (const std::exception& e) {
+            log << "Ignoring previous catalog: " << e.what() << std::endl;
+        }
+    }
+
+    std::vector<ScannedArchive> scanned(archives.size());
+    for (size_t i = 0; i < archives.size(); i++) {
+        scanned[i].path = fs::absolute(archives[i]).lexically_normal().string();
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&]() {
+        for (size_t i = next++; i < scanned.size(); i = next++) {
+            scanArchive(scanned[i], previous.get(), previous_index);
+        }
+    };
+    jobs = std::max(1u, std::min<unsigned>(jobs, unsigned(scanned.size())));
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < jobs; i++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    // Assemble tables, interning every string once.
+    BuildResult result;
+    std::vector<Archive> out_archives;
+    std::vector<Entry> out_entries;
+    std::string strings;
+    std::unordered_map<std::string, uint64_t> interned;
+    auto intern = [&](const std::string& s) {
+        auto it = interned.find(s);
+        if (it != interned.end()) {
+            return it->second;
+        }
+        uint64_t offset = strings.size();
+        strings += s;
+        interned.emplace(s, offset);
+        return offset;
+    };
+
+    for (const auto& sa : scanned) {
+        if (!sa.ok) {
+            if (!sa.error.empty()) {
+                log << "Skipping " << sa.path << ": " << sa.error << std::endl;
+                result.failed++;
+            }
+            continue;
+        }
+        result.scanned++;
+        if (sa.reused) {
+            result.reused++;
+        }
+        Archive a = {};
+        a.path_offset = intern(sa.path);
+        a.path_length = uint32_t(sa.path.size());
+        a.first_entry = uint32_t(out_entries.size());
+        a.entry_count = uint32_t(sa.entries.size());
+        a.size = sa.size;
+        a.mtime = sa.mtime;
+        for (const auto& se : sa.entries) {
+            Entry e = {};
+            e.path_offset = intern(se.path);
+            e.path_length = uint32_t(se.path.size());
+            e.archive = uint32_t(out_archives.size());
+            e.offset = se.offset;
+            e.compressed_size = se.compressed_size;
+            e.uncompressed_size = se.uncompressed_size;
+            e.datetime = se.datetime;
+            e.attrib = se.attrib;
+            e.name_length = se.name_length;
+            out_entries.push_back(e);
+        }
+        out_archives.push_back(a);
+    }
+    if (out_entries.size() >= NONE) {
+        throw std::runtime_error("Too many entries for one catalog");
+    }
+    result.entries = out_entries.size();
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < out_entries.size() * 2) {
+        bucket_count <<= 1;
+    }
+    std::vector<uint32_t> buckets(bucket_count, NONE);
+    for (uint32_t i = 0; i < out_entries.size(); i++) {
+        Entry& e = out_entries[i];
+        std::string_view path(strings.data() + e.path_offset, e.path_length);
+        uint32_t b = uint32_t(fnv1a64_nocase(path.substr(path.size() - e.name_length))) & (bucket_count - 1);
+        e.next = buckets[b];
+        buckets[b] = i;
+    }
+
+    Header hdr = {};
+    memcpy(hdr.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+    hdr.version = VERSION;
+    hdr.archive_count = uint32_t(out_archives.size());
+    hdr.entry_count = uint32_t(out_entries.size());
+    hdr.bucket_count = bucket_count;
+    hdr.strings_size = strings.size();
+    hdr.archives_offset = align8(sizeof(Header));
+    hdr.entries_offset = align8(hdr.archives_offset + out_archives.size() * sizeof(Archive));
+    hdr.buckets_offset = align8(hdr.entries_offset + out_entries.size() * sizeof(Entry));
+    hdr.strings_offset = align8(hdr.buckets_offset + buckets.size() * sizeof(uint32_t));
+
+    // Everything needed from the previous catalog has been copied; unmap it
+    // before it is replaced.
+    previous.reset();
+    writeTableFile(apath, "catalog", [&](std::ofstream& fout) {
+        fout.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        writeAt(fout, hdr.archives_offset, out_archives);
+        writeAt(fout, hdr.entries_offset, out_entries);
+        writeAt(fout, hdr.buckets_offset, buckets);
+        fout.seekp(std::streamoff(hdr.strings_offset), std::ios::beg);
+        fout.write(strings.data(), std::streamsize(strings.size()));
+    });
+    return result;
+}
@@ -0,0 +1,126 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "MappedFile.h"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <iosfwd>
+
+// Persistent index of the contents of many archives.
+//
+// The catalog is a single little-endian file that is mapped into memory and
+// queried in place: a header, a table of archives, a table of entries, a
+// hash table over upper-cased file names and a pool of interned path strings.
+class Catalog {
+public:
+    Catalog(const std::filesystem::path& apath);
+
+    class Header {
+    public:
+        char magic[8];          // "UV3CAT\0\0"
+        uint32_t version;
+        uint32_t archive_count;
+        uint32_t entry_count;
+        uint32_t bucket_count;  // power of two
+        uint64_t strings_size;
+        uint64_t archives_offset;
+        uint64_t entries_offset;
+        uint64_t buckets_offset;
+        uint64_t strings_offset;
+    };
+
+    class Archive {
+    public:
+        uint64_t path_offset;
+        uint32_t path_length;
+        uint32_t first_entry;
+        uint32_t entry_count;
+        uint32_t u1;
+        uint64_t size;          // file size when indexed
+        int64_t mtime;          // modification time when indexed
+    };
+
+    class Entry {
+    public:
+        uint64_t path_offset;   // full path, directory separator: \ (Windows)
+        uint32_t path_length;
+        uint32_t archive;
+        uint32_t offset;
+        uint32_t compressed_size;
+        uint32_t uncompressed_size;
+        uint32_t datetime;
+        uint32_t next;          // next entry in the same hash bucket
+        uint8_t attrib;
+        uint8_t name_length;    // file name = last name_length bytes of path
+        uint16_t u1;
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    class BuildResult {
+    public:
+        size_t scanned = 0;
+        size_t reused = 0;
+        size_t failed = 0;
+        size_t entries = 0;
+    };
+
+    // Index `archives` with `jobs` threads and write the catalog to `apath`.
+    // If `apath` already holds a catalog, archives whose size and mtime are
+    // unchanged are copied from it instead of being parsed again. Files that
+    // are not InstallShield V3 archives are skipped; damaged archives are
+    // reported to `log`.
+    static BuildResult build(const std::filesystem::path& apath,
+            const std::vector<std::filesystem::path>& archives,
+            unsigned jobs, std::ostream& log);
+
+    // Look up entries by file name ("FOO.DLL") or by full path
+    // ("SYSTEM\FOO.DLL"), ignoring case.
+    std::vector<const Entry*> find(std::string_view name) const;
+
+    const Header& header() const {
+        return *m_header;
+    }
+    const Archive& archive(uint32_t index) const {
+        return m_archives[index];
+    }
+    const Entry& entry(uint32_t index) const {
+        return m_entries[index];
+    }
+    std::string_view archivePath(const Archive& archive) const {
+        return string(archive.path_offset, archive.path_length);
+    }
+    std::string_view entryPath(const Entry& entry) const {
+        return string(entry.path_offset, entry.path_length);
+    }
+
+protected:
+    std::string_view string(uint64_t offset, uint32_t length) const {
+        return std::string_view(m_strings + offset, length);
+    }
+
+    MappedFile m_file;
+    const Header* m_header;
+    const Archive* m_archives;
+    const Entry* m_entries;
+    const uint32_t* m_buckets;
+    const char* m_strings;
+};
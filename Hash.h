@@ -0,0 +1,45 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// 64-bit FNV-1a. Not cryptographic; used for hash tables and quick content
+// comparisons.
+inline uint64_t fnv1a64(const void* data, size_t len, uint64_t h = 0xcbf29ce484222325ULL) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+// Case-insensitive (ASCII) variant, for DOS file names.
+inline uint64_t fnv1a64_nocase(std::string_view s) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (char c : s) {
+        if (c >= 'a' && c <= 'z') {
+            c = char(c - 'a' + 'A');
+        }
+        h ^= uint8_t(c);
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
@@ -15,54 +15,107 @@ limitations under the License.
 */
 
 #include "ISArchiveV3.h"
+#include "Hash.h"
+#include "MappedFile.h"
+#include "SeekIndex.h"
 #include <algorithm>
-#include <cassert>
+#include <chrono>
 #include <sstream>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <exception>
-extern "C" {
-    #include "blast.h"
-};
 
 namespace fs = std::filesystem;
 
 
-class Directory {
+// Directory as stored in the TOC: a full path and the number of files that
+// follow in the file table.
+class DirectoryRecord {
 public:
     std::string name;
     uint16_t file_count;
 };
 
 
-ISArchiveV3::ISArchiveV3(const std::filesystem::path& apath)
-    : m_path(apath)
+ISArchiveV3::ISArchiveV3(const std::filesystem::path& apath, uint64_t base_offset, Stats* stats)
+    : m_path(apath), m_base_offset(base_offset), m_stats(stats), fin(nullptr)
 {
-    std::vector<Directory> directories;
-
-    fin.open(apath, std::ios::in | std::ios::binary);
-    if (!fin.is_open()) {
+    Stats::Timer timer(m_stats, Stats::TOC_PARSE);
+    if (!m_filebuf.open(apath, std::ios::in | std::ios::binary)) {
         std::ostringstream os;
         os << "Cannot open archive: " << apath;
         throw std::runtime_error(os.str());
     }
-    uint64_t file_size = fs::file_size(apath);
-    assert(file_size > sizeof(Header));
+    fin.rdbuf(&m_filebuf);
+    parse(fs::file_size(apath));
+}
+
+ISArchiveV3::ISArchiveV3(std::shared_ptr<const MappedFile> map, uint64_t base_offset, Stats* stats)
+    : m_path(map->path()), m_base_offset(base_offset), m_stats(stats), m_map(map), fin(nullptr)
+{
+    Stats::Timer timer(m_stats, Stats::TOC_PARSE);
+    m_membuf = std::make_unique<MemoryBuf>(m_map->data(), m_map->size());
+    fin.rdbuf(m_membuf.get());
+    parse(m_map->size());
+}
+
+ISArchiveV3::MemoryBuf::MemoryBuf(const uint8_t* data, size_t size) {
+    char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+    setg(begin, begin, begin + size);
+}
+
+std::streambuf::pos_type ISArchiveV3::MemoryBuf::seekoff(off_type off,
+        std::ios_base::seekdir dir, std::ios_base::openmode which)
+{
+    off_type base = dir == std::ios_base::beg ? 0
+        : dir == std::ios_base::cur ? gptr() - eback()
+        : egptr() - eback();
+    return seekpos(pos_type(base + off), which);
+}
+
+std::streambuf::pos_type ISArchiveV3::MemoryBuf::seekpos(pos_type pos, std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in) || pos < 0 || off_type(pos) > egptr() - eback()) {
+        return pos_type(off_type(-1));
+    }
+    setg(eback(), eback() + off_type(pos), egptr());
+    return pos;
+}
+
+void ISArchiveV3::parse(uint64_t file_size) {
+    std::vector<DirectoryRecord> directories;
+    const uint64_t base_offset = m_base_offset;
+    if (file_size <= base_offset || file_size - base_offset <= sizeof(Header)) {
+        throw std::runtime_error("Archive truncated");
+    }
+    fin.seekg(std::streamoff(base_offset), std::ios::beg);
     fin.read(reinterpret_cast<char*>(&hdr), sizeof(Header));
-    assert(hdr.signature1 == 0x8C655D13 && hdr.signature2 == 0x02013a);
-    assert(hdr.toc_address < file_size);
-    fin.seekg(hdr.toc_address, std::ios::beg);
+    if (!isValidHeader(hdr, file_size - base_offset)) {
+        std::ostringstream os;
+        os << "Not an InstallShield V3 archive: " << m_path;
+        if (base_offset) {
+            os << " at offset " << base_offset;
+        }
+        throw std::runtime_error(os.str());
+    }
+    fin.seekg(std::streamoff(base_offset + hdr.toc_address), std::ios::beg);
 
     for (int i = 0; i < hdr.dir_count; i++) {
         uint16_t file_count = read<uint16_t>();
         uint16_t chunk_size = read<uint16_t>();
         std::string name = readString16();
+        if (fin.fail() || chunk_size < name.length() + 6) {
+            throw std::runtime_error("Corrupt directory table");
+        }
         fin.ignore(chunk_size - uint16_t(name.length()) - 6);
         directories.push_back({name, file_count});
     }
 
-    for (Directory& directory : directories) {
+    std::vector<uint32_t> file_records;
+    m_files.reserve(hdr.file_count);
+    file_records.reserve(hdr.file_count);
+    for (size_t d = 0; d < directories.size(); d++) {
+        const DirectoryRecord& directory = directories[d];
         for (int i = 0; i < directory.file_count; i++) {
             File f;
 
@@ -80,24 +133,218 @@ ISArchiveV3::ISArchiveV3(const std::filesystem::path& apath)
             uint8_t u3 = read<uint8_t>();
             (void)u3;
             f.volume_start = read<uint8_t>();
-            f.name = readString8();
-            fin.ignore(chunk_size - uint16_t(f.name.length()) - 30);
+            uint8_t name_length = read<uint8_t>();
+            char name[256];
+            fin.read(name, name_length);
+            if (fin.fail() || chunk_size < name_length + 30) {
+                throw std::runtime_error("Corrupt file table");
+            }
+            fin.ignore(chunk_size - name_length - 30);
 
+            std::string_view full_path;
             if (directory.name.length()) {
-                f.full_path = directory.name + "\\" + f.name;
+                full_path = m_strings.add({directory.name, "\\", std::string_view(name, name_length)});
             } else {
-                f.full_path = f.name;
+                full_path = m_strings.add(std::string_view(name, name_length));
+            }
+            if (!isValidName(full_path)) {
+                throw std::runtime_error("Invalid file path: " + std::string(full_path));
             }
-            if (!isValidName(f.full_path)) {
-                throw std::runtime_error(std::string("Invalid file path: ") + f.full_path);
+            // Nothing may be read or allocated past the end of the data.
+            if (uint64_t(f.offset) + f.compressed_size > file_size - base_offset) {
+                throw std::runtime_error("Entry extends past the end of the archive: "
+                        + std::string(full_path));
             }
+            f.m_path = full_path.data();
+            f.m_path_length = uint32_t(full_path.size());
+            f.m_name_length = name_length;
 
             m_files.push_back(f);
+            file_records.push_back(uint32_t(d));
         }
     }
+
+    std::vector<std::string_view> record_names;
+    for (const auto& directory : directories) {
+        record_names.push_back(directory.name);
+    }
+    buildTree(record_names, file_records);
+    buildIndex();
+}
+
+void ISArchiveV3::buildIndex() {
+    size_t buckets = 16;
+    while (buckets < m_files.size() * 2) {
+        buckets *= 2;
+    }
+    m_index.assign(buckets, 0);
+    for (size_t i = 0; i < m_files.size(); i++) {
+        std::string_view path = m_files[i].fullPath();
+        size_t b = fnv1a64(path.data(), path.size()) & (buckets - 1);
+        // The first of several entries with the same path wins.
+        while (m_index[b] && m_files[m_index[b] - 1].fullPath() != path) {
+            b = (b + 1) & (buckets - 1);
+        }
+        if (!m_index[b]) {
+            m_index[b] = uint32_t(i + 1);
+        }
+    }
+}
+
+void ISArchiveV3::buildTree(const std::vector<std::string_view>& records, std::vector<uint32_t>& file_records) {
+    // Collect nodes for every TOC directory and its ancestors, which need
+    // not be listed themselves.
+    class Node {
+    public:
+        std::string_view full_path;
+        uint32_t name_offset;
+        uint32_t parent;
+        std::vector<uint32_t> children;
+        uint32_t first_record; // first TOC directory mapped to this node
+    };
+    const uint32_t NONE = 0xffffffff;
+    std::vector<Node> nodes = {{m_strings.add(""), 0, 0, {}, NONE}};
+    std::unordered_map<std::string_view, uint32_t> by_path = {{"", 0}};
+    std::vector<uint32_t> record_node(records.size());
+    for (uint32_t r = 0; r < records.size(); r++) {
+        std::string_view path = records[r];
+        uint32_t node = 0;
+        size_t begin = 0;
+        while (begin < path.size()) {
+            size_t end = path.find('\\', begin);
+            if (end == std::string::npos) {
+                end = path.size();
+            }
+            std::string_view prefix = path.substr(0, end);
+            auto it = by_path.find(prefix);
+            if (it == by_path.end()) {
+                uint32_t child = uint32_t(nodes.size());
+                prefix = m_strings.add(prefix);
+                nodes.push_back({prefix, uint32_t(begin), node, {}, NONE});
+                nodes[node].children.push_back(child);
+                it = by_path.emplace(prefix, child).first;
+            }
+            node = it->second;
+            begin = end + 1;
+        }
+        record_node[r] = node;
+        if (nodes[node].first_record == NONE) {
+            nodes[node].first_record = r;
+        }
+    }
+
+    // Number nodes breadth-first, so that the children of each directory
+    // form one contiguous range.
+    std::vector<uint32_t> order = {0};
+    std::vector<uint32_t> index_of(nodes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        index_of[order[i]] = uint32_t(i);
+        for (uint32_t child : nodes[order[i]].children) {
+            order.push_back(child);
+        }
+    }
+
+    // Files are stored grouped by TOC directory. A directory listed twice
+    // would split its files, so regroup them in that (unusual) case.
+    std::vector<uint32_t> file_nodes(m_files.size());
+    bool grouped = true;
+    for (size_t i = 0; i < m_files.size(); i++) {
+        file_nodes[i] = record_node[file_records[i]];
+        if (i > 0 && file_nodes[i] != file_nodes[i - 1]
+                && nodes[file_nodes[i]].first_record != file_records[i]) {
+            grouped = false;
+        }
+    }
+    if (!grouped) {
+        std::vector<size_t> perm(m_files.size());
+        for (size_t i = 0; i < perm.size(); i++) {
+            perm[i] = i;
+        }
+        std::stable_sort(perm.begin(), perm.end(), [&](size_t a, size_t b) {
+            return nodes[file_nodes[a]].first_record < nodes[file_nodes[b]].first_record;
+        });
+        std::vector<File> files;
+        std::vector<uint32_t> sorted_nodes;
+        for (size_t i : perm) {
+            files.push_back(std::move(m_files[i]));
+            sorted_nodes.push_back(file_nodes[i]);
+        }
+        m_files = std::move(files);
+        file_nodes = std::move(sorted_nodes);
+    }
+
+    m_directories.resize(nodes.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        Node& node = nodes[order[i]];
+        Directory& dir = m_directories[i];
+        dir.m_path = node.full_path;
+        dir.m_name_offset = node.name_offset;
+        dir.parent = index_of[node.parent];
+        dir.first_child = node.children.empty() ? 0 : index_of[node.children.front()];
+        dir.child_count = uint32_t(node.children.size());
+        dir.first_file = 0;
+        dir.file_count = 0;
+    }
+    for (size_t i = 0; i < m_files.size(); i++) {
+        Directory& dir = m_directories[index_of[file_nodes[i]]];
+        if (dir.file_count == 0) {
+            dir.first_file = uint32_t(i);
+        }
+        dir.file_count++;
+    }
+    m_directory_index.reserve(m_directories.size());
+    for (size_t i = 0; i < m_directories.size(); i++) {
+        m_directory_index.emplace(m_directories[i].fullPath(), i);
+    }
+}
+
+const std::vector<ISArchiveV3::Directory>& ISArchiveV3::directories() const {
+    return m_directories;
+}
+
+const ISArchiveV3::Directory* ISArchiveV3::directoryByPath(std::string_view full_path) const {
+    auto it = m_directory_index.find(full_path);
+    return it == m_directory_index.end() ? nullptr : &m_directories[it->second];
+}
+
+const ISArchiveV3::File* ISArchiveV3::file(std::string_view full_path) const {
+    return fileByPath(full_path);
+}
+
+std::vector<const ISArchiveV3::File*> ISArchiveV3::subtree(const Directory& dir) const {
+    std::vector<const File*> result;
+    std::vector<const Directory*> pending = {&dir};
+    while (!pending.empty()) {
+        const Directory* d = pending.back();
+        pending.pop_back();
+        for (uint32_t i = 0; i < d->file_count; i++) {
+            result.push_back(&m_files[d->first_file + i]);
+        }
+        for (uint32_t i = d->child_count; i > 0; i--) {
+            pending.push_back(&m_directories[d->first_child + i - 1]);
+        }
+    }
+    return result;
+}
+
+bool ISArchiveV3::isValidHeader(const Header& hdr, uint64_t available) {
+    if (hdr.signature1 != 0x8C655D13 || hdr.signature2 != 0x02013a) {
+        return false;
+    }
+    if (hdr.toc_address < sizeof(Header) || hdr.toc_address >= available) {
+        return false;
+    }
+    // Every directory record takes at least 6 bytes and every file record at
+    // least 30, so the counts must fit between the TOC and the end of data.
+    uint64_t toc_min = uint64_t(hdr.dir_count) * 6 + uint64_t(hdr.file_count) * 30;
+    return toc_min <= available - hdr.toc_address;
 }
 
 std::tm ISArchiveV3::File::tm() const {
+    return dosDateTime(datetime);
+}
+
+std::tm ISArchiveV3::dosDateTime(uint32_t datetime) {
     // source: https://github.com/lephilousophe/idecomp
     uint16_t file_date = datetime & 0xffff;
     uint16_t file_time = (datetime >> 16) & 0xffff;
@@ -113,7 +360,7 @@ std::tm ISArchiveV3::File::tm() const {
 }
 
 std::filesystem::path ISArchiveV3::File::path() const {
-    std::string fp = full_path;
+    std::string fp(fullPath());
     // windows paths are wchar_t, convert
     char pref_seperator = fs::path::preferred_separator;
     std::replace(fp.begin(), fp.end(),
@@ -121,6 +368,14 @@ std::filesystem::path ISArchiveV3::File::path() const {
     return std::filesystem::path(fp);
 }
 
+uint64_t ISArchiveV3::File::decodedSizeHint() const {
+    if (attrib & Attributes::UNCOMPRESSED) {
+        return compressed_size;
+    }
+    // Longest matches: 518 bytes in 22 bits.
+    return std::min<uint64_t>(uncompressed_size, uint64_t(compressed_size) * 190);
+}
+
 std::string ISArchiveV3::File::attribString() const {
     std::ostringstream os;
     os << (attrib & File::Attributes::ARCHIVE  ? 'A' : '_');
@@ -134,24 +389,118 @@ const std::vector<ISArchiveV3::File>& ISArchiveV3::files() const {
     return m_files;
 }
 
-const ISArchiveV3::File* ISArchiveV3::fileByPath(const std::string& full_path) const {
-    // std::map would be more efficient but let's keep it simple for now.
-    for (const auto& file : m_files) {
-        if (file.full_path == full_path) {
-            return &file;
+const ISArchiveV3::File* ISArchiveV3::fileByPath(std::string_view full_path) const {
+    size_t mask = m_index.size() - 1;
+    size_t b = fnv1a64(full_path.data(), full_path.size()) & mask;
+    for (; m_index[b]; b = (b + 1) & mask) {
+        const File& f = m_files[m_index[b] - 1];
+        if (f.fullPath() == full_path) {
+            return &f;
         }
     }
     return nullptr;
 }
 
-bool ISArchiveV3::exists(const std::string& full_path) const {
+bool ISArchiveV3::exists(std::string_view full_path) const {
     return fileByPath(full_path) != nullptr;
 }
 
+std::vector<uint8_t> ISArchiveV3::decompress(std::string_view full_path) {
+    const File* file = fileByPath(full_path);
+    if (file == nullptr) {
+        std::ostringstream os;
+        os << "decompress() called with invalid path: " << full_path;
+        throw std::runtime_error(os.str());
+    }
+    if (m_map) {
+        if (m_base_offset + file->offset + file->compressed_size > m_map->size()) {
+            throw std::runtime_error("Read failed");
+        }
+        if (m_stats) {
+            m_stats->bytes_in += file->compressed_size;
+        }
+        return decodeRange(*file, m_map->data() + m_base_offset + file->offset, file->compressed_size);
+    }
+    return decode(*file, readCompressed(*file));
+}
+
+std::vector<uint8_t> ISArchiveV3::readCompressed(std::string_view full_path) {
+    const File* file = fileByPath(full_path);
+    if (file == nullptr) {
+        std::ostringstream os;
+        os << "readCompressed() called with invalid path: " << full_path;
+        throw std::runtime_error(os.str());
+    }
+    return readCompressed(*file);
+}
+
+std::vector<uint8_t> ISArchiveV3::readCompressed(const File& file) {
+    std::vector<uint8_t> buf;
+    readCompressed(file, buf);
+    return buf;
+}
+
+const uint8_t* ISArchiveV3::storedBytes(const File& file, uint64_t begin, uint64_t length,
+        std::vector<uint8_t>& buf)
+{
+    checkLimits(file);
+    if (m_map) {
+        if (m_base_offset + file.offset + file.compressed_size > m_map->size()) {
+            throw std::runtime_error("Read failed");
+        }
+        if (m_stats) {
+            m_stats->bytes_in += length;
+        }
+        return m_map->data() + m_base_offset + file.offset + begin;
+    }
+    buf.resize(length);
+    {
+        Stats::Timer timer(m_stats, Stats::READ);
+        fin.seekg(std::streamoff(m_base_offset + file.offset + begin), std::ios::beg);
+        fin.read(reinterpret_cast<char*>(buf.data()), std::streamsize(length));
+        if (fin.fail()) {
+            throw std::runtime_error("Read failed");
+        }
+    }
+    if (m_stats) {
+        m_stats->bytes_in += length;
+    }
+    return buf.data();
+}
+
+void ISArchiveV3::decompress(const File& file, std::vector<uint8_t>& out, std::vector<uint8_t>& input) {
+    const uint8_t* data = storedBytes(file, 0, file.compressed_size, input);
+    decodeRange(file, data, file.compressed_size, out);
+    if (m_stats && data == input.data()) {
+        m_stats->buffer(input.capacity() + out.capacity());
+    }
+}
+
+void ISArchiveV3::readCompressed(const File& file, std::vector<uint8_t>& out) {
+    const uint8_t* data = storedBytes(file, 0, file.compressed_size, out);
+    if (data != out.data()) {
+        out.assign(data, data + file.compressed_size);
+    }
+}
+
+void ISArchiveV3::decode(const File& file, const std::vector<uint8_t>& compressed, std::vector<uint8_t>& out) {
+    decodeRange(file, compressed.data(), compressed.size(), out);
+    if (m_stats) {
+        m_stats->buffer(compressed.capacity() + out.capacity());
+    }
+}
+
+struct BlastInput {
+    const uint8_t* data;
+    size_t size;
+};
+
 unsigned _blast_in(void *how, unsigned char **buf) {
-    std::vector<unsigned char> *inbuf = reinterpret_cast<std::vector<unsigned char>*>(how);
-    *buf = inbuf->data();
-    return unsigned(inbuf->size());
+    BlastInput *in = reinterpret_cast<BlastInput*>(how);
+    *buf = const_cast<unsigned char*>(in->data);
+    unsigned len = unsigned(in->size);
+    in->size = 0; // all input is handed over at once
+    return len;
 }
 
 int _blast_out(void *how, unsigned char *buf, unsigned len) {
@@ -160,37 +509,224 @@ int _blast_out(void *how, unsigned char *buf, unsigned len) {
     return false; // would indicate write error
 }
 
-std::vector<uint8_t> ISArchiveV3::decompress(const std::string& full_path) {
-    if (!exists(full_path)) {
-        std::ostringstream os;
-        os << "decompress() called with invalid path: " << full_path;
-        throw std::runtime_error(os.str());
+[[noreturn]] static void failEntry(const ISArchiveV3::File& file, const char* reason) {
+    std::ostringstream os;
+    os << reason << ": " << file.fullPath();
+    throw std::runtime_error(os.str());
+}
+
+// The limits that can be judged from the TOC alone.
+static void checkEntryLimits(const ISArchiveV3::File& file, const ISArchiveV3::Limits& limits) {
+    bool stored = file.attrib & ISArchiveV3::File::Attributes::UNCOMPRESSED;
+    uint64_t declared = stored ? file.compressed_size : file.uncompressed_size;
+    if (limits.max_entry_size && declared > limits.max_entry_size) {
+        failEntry(file, "Entry larger than the size limit");
     }
-    const File* file = fileByPath(full_path);
-    assert(file != nullptr);
-    fin.seekg(file->offset, std::ios::beg);
-    std::vector<unsigned char> buf(file->compressed_size);
-    std::vector<unsigned char> out;
-    fin.read(reinterpret_cast<char*>(&buf[0]), file->compressed_size);
-    if (fin.fail()) {
-        throw std::runtime_error("Read failed");
+    if (!stored && limits.max_ratio
+            && file.uncompressed_size > uint64_t(file.compressed_size) * limits.max_ratio) {
+        failEntry(file, "Entry exceeds the compression ratio limit");
     }
+}
+
+void ISArchiveV3::checkLimits(const File& file) const {
+    checkEntryLimits(file, m_limits);
+}
+
+// Sits between blast() and an output function and enforces the decoding
+// limits on every piece of output, so that a corrupt or hostile entry is
+// stopped within one window of output past a limit.
+class BlastGuard {
+public:
+    BlastGuard(const ISArchiveV3::File& file, const ISArchiveV3::Limits& limits,
+            std::atomic<uint64_t>& total, blast_out outfun, void* outhow, uint64_t position = 0)
+        : m_file(file), m_limits(limits), m_total(total), m_outfun(outfun), m_outhow(outhow),
+          m_position(position)
+    {
+        checkEntryLimits(file, limits);
+        bool stored = file.attrib & ISArchiveV3::File::Attributes::UNCOMPRESSED;
+        m_declared = stored ? file.compressed_size : file.uncompressed_size;
+        if (limits.max_time.count()) {
+            m_deadline = std::chrono::steady_clock::now() + limits.max_time;
+        }
+    }
+
+    // Account for `len` more bytes of output. False once a limit is exceeded.
+    bool admit(uint64_t len) {
+        m_position += len;
+        if (m_position > m_declared) {
+            m_error = "Entry decodes past its declared size";
+        } else if (m_limits.max_total_size
+                && m_total.fetch_add(len, std::memory_order_relaxed) + len > m_limits.max_total_size) {
+            m_error = "Archive exceeds the total size limit";
+        } else if (m_limits.max_time.count() && std::chrono::steady_clock::now() > m_deadline) {
+            m_error = "Entry exceeds the decoding time limit";
+        }
+        return m_error == nullptr;
+    }
+
+    // Throws if decoding was stopped by a limit.
+    void check() const {
+        if (m_error) {
+            failEntry(m_file, m_error);
+        }
+    }
+
+    static int out(void *how, unsigned char *buf, unsigned len) {
+        BlastGuard *guard = reinterpret_cast<BlastGuard*>(how);
+        if (!guard->admit(len)) {
+            return 1;
+        }
+        return guard->m_outfun(guard->m_outhow, buf, len);
+    }
+
+private:
+    const ISArchiveV3::File& m_file;
+    const ISArchiveV3::Limits& m_limits;
+    std::atomic<uint64_t>& m_total;
+    blast_out m_outfun;
+    void* m_outhow;
+    uint64_t m_position; // output bytes so far
+    uint64_t m_declared;
+    std::chrono::steady_clock::time_point m_deadline;
+    const char* m_error = nullptr;
+};
 
-    if (file->attrib & File::Attributes::UNCOMPRESSED) {
+std::vector<uint8_t> ISArchiveV3::decode(const File& file, std::vector<uint8_t> buf) {
+    if (file.attrib & File::Attributes::UNCOMPRESSED) {
+        // Stored contents are already in memory; only the accounting applies.
+        BlastGuard guard(file, m_limits, m_decoded, nullptr, nullptr);
+        guard.admit(buf.size());
+        guard.check();
+        if (m_stats) {
+            m_stats->entries++;
+            m_stats->bytes_out += buf.size();
+            m_stats->buffer(buf.capacity());
+        }
         return buf;
     }
+    auto out = decodeRange(file, buf.data(), buf.size());
+    if (m_stats) {
+        m_stats->buffer(buf.capacity() + out.capacity());
+    }
+    return out;
+}
+
+std::vector<uint8_t> ISArchiveV3::decodeRange(const File& file, const uint8_t* data, size_t size) {
+    std::vector<uint8_t> out;
+    decodeRange(file, data, size, out);
+    return out;
+}
+
+void ISArchiveV3::decodeRange(const File& file, const uint8_t* data, size_t size, std::vector<uint8_t>& out) {
+    if (m_stats) {
+        m_stats->entries++;
+    }
+    BlastGuard guard(file, m_limits, m_decoded, _blast_out, static_cast<void*>(&out));
+    if (file.attrib & File::Attributes::UNCOMPRESSED) {
+        guard.admit(size);
+        guard.check();
+        if (m_stats) {
+            m_stats->bytes_out += size;
+            m_stats->buffer(size);
+        }
+        out.assign(data, data + size);
+        return;
+    }
 
+    out.clear();
+    BlastInput in = {data, size};
     int ret;
-    unsigned left = 0;
-    ret = blast(_blast_in, static_cast<void*>(&buf), _blast_out, static_cast<void*>(&out), &left, nullptr);
+    {
+        Stats::Timer timer(m_stats, Stats::DECODE);
+        ret = blast(_blast_in, static_cast<void*>(&in), BlastGuard::out, static_cast<void*>(&guard),
+                nullptr, nullptr);
+    }
+    guard.check();
     if (ret != 0) {
         std::ostringstream os;
         os << "Blast decompression error: " << ret;
         throw std::runtime_error(os.str());
-        return {};
     }
+    if (m_stats) {
+        m_stats->bytes_out += out.size();
+        m_stats->buffer(out.capacity());
+    }
+}
 
-    return out;
+void ISArchiveV3::decompress(const File& file, const Sink& sink) {
+    if (m_map) {
+        if (m_base_offset + file.offset + file.compressed_size > m_map->size()) {
+            throw std::runtime_error("Read failed");
+        }
+        if (m_stats) {
+            m_stats->bytes_in += file.compressed_size;
+        }
+        decodeRange(file, m_map->data() + m_base_offset + file.offset, file.compressed_size, sink);
+        return;
+    }
+    auto buf = readCompressed(file);
+    decodeRange(file, buf.data(), buf.size(), sink);
+}
+
+struct BlastSink {
+    const ISArchiveV3::Sink* sink;
+    uint64_t written;
+    bool timed;         // measure time spent in the sink
+    uint64_t sink_ns;
+};
+
+int _blast_sink(void *how, unsigned char *buf, unsigned len) {
+    BlastSink *out = reinterpret_cast<BlastSink*>(how);
+    out->written += len;
+    if (!out->timed) {
+        return (*out->sink)(buf, len) ? 0 : 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool ok = (*out->sink)(buf, len);
+    out->sink_ns += uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    return ok ? 0 : 1;
+}
+
+void ISArchiveV3::decodeRange(const File& file, const uint8_t* data, size_t size, const Sink& sink) {
+    if (m_stats) {
+        m_stats->entries++;
+    }
+    BlastSink out = {&sink, 0, m_stats != nullptr, 0};
+    BlastGuard guard(file, m_limits, m_decoded, _blast_sink, static_cast<void*>(&out));
+    if (file.attrib & File::Attributes::UNCOMPRESSED) {
+        guard.admit(size);
+        guard.check();
+        if (m_stats) {
+            m_stats->bytes_out += size;
+        }
+        if (!sink(data, size)) {
+            throw std::runtime_error("Output aborted");
+        }
+        return;
+    }
+
+    BlastInput in = {data, size};
+    int ret;
+    {
+        Stats::Timer timer(m_stats, Stats::DECODE);
+        ret = blast(_blast_in, static_cast<void*>(&in), BlastGuard::out, static_cast<void*>(&guard),
+                nullptr, nullptr);
+    }
+    if (m_stats) {
+        // The sink times itself, e.g. as WRITE.
+        m_stats->nanoseconds[Stats::DECODE] -= out.sink_ns;
+        m_stats->bytes_out += out.written;
+    }
+    guard.check();
+    if (ret == 1) {
+        throw std::runtime_error("Output aborted");
+    }
+    if (ret != 0) {
+        std::ostringstream os;
+        os << "Blast decompression error: " << ret;
+        throw std::runtime_error(os.str());
+    }
 }
 
 template<class T> T ISArchiveV3::read() {
@@ -199,13 +735,6 @@ template<class T> T ISArchiveV3::read() {
     return re;
 }
 
-std::string ISArchiveV3::readString8() {
-    uint8_t len = read<uint8_t>();
-    std::vector<char> buf(len);
-    fin.read(&buf[0], len);
-    return std::string(buf.begin(), buf.end());
-}
-
 std::string ISArchiveV3::readString16() {
     uint16_t len = read<uint16_t>();
     std::vector<char> buf(len);
@@ -213,12 +742,109 @@ std::string ISArchiveV3::readString16() {
     return std::string(buf.begin(), buf.end());
 }
 
-bool ISArchiveV3::isValidName(const std::string& name) const {
-    if (name.find("..\\") != std::string::npos) {
+bool ISArchiveV3::isValidName(std::string_view name) const {
+    if (name.find("..\\") != std::string_view::npos) {
         return false;
     }
-    if (name.find("../") != std::string::npos) {
+    if (name.find("../") != std::string_view::npos) {
         return false;
     }
     return true;
 }
+
+int _blast_mark(void *how, const blast_checkpoint *cp) {
+    reinterpret_cast<SeekIndex*>(how)->add(*cp);
+    return 0;
+}
+
+int _blast_discard(void *, unsigned char *, unsigned) {
+    return 0;
+}
+
+SeekIndex ISArchiveV3::buildSeekIndex(const File& file, uint32_t interval) {
+    SeekIndex index(file, interval);
+    if (file.attrib & File::Attributes::UNCOMPRESSED) {
+        return index;
+    }
+    BlastGuard guard(file, m_limits, m_decoded, _blast_discard, nullptr);
+    std::vector<uint8_t> buf;
+    BlastInput in = {storedBytes(file, 0, file.compressed_size, buf), file.compressed_size};
+    int ret;
+    {
+        Stats::Timer timer(m_stats, Stats::DECODE);
+        ret = blast_index(_blast_in, static_cast<void*>(&in), BlastGuard::out, static_cast<void*>(&guard),
+                _blast_mark, static_cast<void*>(&index), interval);
+    }
+    guard.check();
+    if (ret != 0) {
+        std::ostringstream os;
+        os << "Blast decompression error: " << ret;
+        throw std::runtime_error(os.str());
+    }
+    return index;
+}
+
+// Collects output bytes [offset, offset + want) and stops decoding after.
+struct BlastRange {
+    uint64_t position; // of the next output byte
+    uint64_t offset;
+    size_t want;
+    std::vector<uint8_t> data;
+};
+
+int _blast_range(void *how, unsigned char *buf, unsigned len) {
+    BlastRange *r = reinterpret_cast<BlastRange*>(how);
+    uint64_t end = r->position + len;
+    uint64_t from = std::max(r->position, r->offset);
+    uint64_t to = std::min(end, r->offset + r->want);
+    if (from < to) {
+        r->data.insert(r->data.end(), buf + (from - r->position), buf + (to - r->position));
+    }
+    r->position = end;
+    return r->data.size() == r->want; // done: stop decoding
+}
+
+std::vector<uint8_t> ISArchiveV3::readAt(const File& file, uint64_t offset, size_t len,
+        const SeekIndex* index)
+{
+    if (index && !index->matches(file)) {
+        throw std::runtime_error("Seek index does not belong to this entry");
+    }
+    std::vector<uint8_t> buf;
+    if (file.attrib & File::Attributes::UNCOMPRESSED) {
+        if (offset >= file.compressed_size) {
+            return {};
+        }
+        len = size_t(std::min<uint64_t>(len, file.compressed_size - offset));
+        const uint8_t* data = storedBytes(file, offset, len, buf);
+        return std::vector<uint8_t>(data, data + len);
+    }
+    if (offset >= file.uncompressed_size || len == 0) {
+        return {};
+    }
+    len = size_t(std::min<uint64_t>(len, file.uncompressed_size - offset));
+
+    const blast_checkpoint* cp = index ? index->find(offset) : nullptr;
+    uint64_t begin = cp ? cp->in : 0;
+    BlastInput in = {storedBytes(file, begin, file.compressed_size - begin, buf),
+        size_t(file.compressed_size - begin)};
+    BlastRange out = {cp ? cp->out : 0, offset, len, {}};
+    out.data.reserve(len);
+    BlastGuard guard(file, m_limits, m_decoded, _blast_range, static_cast<void*>(&out), out.position);
+    int ret;
+    {
+        Stats::Timer timer(m_stats, Stats::DECODE);
+        if (cp) {
+            ret = blast_resume(cp, _blast_in, static_cast<void*>(&in), BlastGuard::out, static_cast<void*>(&guard));
+        } else {
+            ret = blast(_blast_in, static_cast<void*>(&in), BlastGuard::out, static_cast<void*>(&guard), nullptr, nullptr);
+        }
+    }
+    guard.check();
+    if (ret != 0 && !(ret == 1 && out.data.size() == len)) {
+        std::ostringstream os;
+        os << "Blast decompression error: " << ret;
+        throw std::runtime_error(os.str());
+    }
+    return std::move(out.data);
+}
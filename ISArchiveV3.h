@@ -19,11 +19,31 @@ limitations under the License.
 #include <fstream>
 #include <vector>
 #include <map>
+#include <string_view>
+#include <unordered_map>
+#include <atomic>
 #include <chrono>
+#include <functional>
+#include <memory>
+#include <streambuf>
+#include "Stats.h"
+#include "StringArena.h"
+
+class MappedFile;
+class SeekIndex;
 
 class ISArchiveV3 {
 public:
-    ISArchiveV3(const std::filesystem::path& apath);
+    // `base_offset` locates an archive embedded in a larger file, e.g. a
+    // self-extracting executable or a disk image. All offsets stored in the
+    // archive are relative to it.
+    // If `stats` is given, TOC parsing, reads and decoding are accounted to it.
+    ISArchiveV3(const std::filesystem::path& apath, uint64_t base_offset = 0,
+            Stats* stats = nullptr);
+    // Read the archive from a memory-mapped file. Entries are decoded straight
+    // from the mapping, and decompress() may be called from several threads.
+    ISArchiveV3(std::shared_ptr<const MappedFile> map, uint64_t base_offset = 0,
+            Stats* stats = nullptr);
 
     class  __attribute__ ((packed)) Header {
     public:
@@ -48,16 +68,24 @@ public:
         uint32_t u6;
     };
 
+    // Entry of the file table. Kept small: both names are views into the
+    // archive's string arena, where the name is the tail of the full path.
     class File {
     public:
-        std::string name;
-        std::string full_path; // Directory separator: \ (Windows)
-        uint16_t index; // position in archive
+        // Directory separator: \ (Windows). NUL-terminated.
+        std::string_view fullPath() const {
+            return std::string_view(m_path, m_path_length);
+        }
+        std::string_view name() const {
+            return std::string_view(m_path + m_path_length - m_name_length, m_name_length);
+        }
+
         uint32_t compressed_size;
         uint32_t uncompressed_size;
         uint32_t datetime;
-        uint8_t attrib;
         uint32_t offset;
+        uint16_t index; // position in archive
+        uint8_t attrib;
         uint8_t is_split;
         uint8_t volume_start, volume_end;
 
@@ -71,29 +99,162 @@ public:
 
         std::tm tm() const;
         std::filesystem::path path() const;
+        // uncompressed_size, or less if the stored bytes cannot expand that
+        // far: an implode stream grows at most about 190-fold.
+        uint64_t decodedSizeHint() const;
         std::string attribString() const;
+
+    private:
+        friend class ISArchiveV3;
+        const char* m_path;
+        uint32_t m_path_length;
+        uint8_t m_name_length;
     };
 
+    // Node of the directory tree. directories()[0] is the root; the children
+    // of a directory, and the files directly in it, are contiguous ranges of
+    // directories() and files().
+    class Directory {
+    public:
+        // Directory separator: \ (Windows). Empty for the root.
+        std::string_view fullPath() const {
+            return m_path;
+        }
+        // last path component
+        std::string_view name() const {
+            return m_path.substr(m_name_offset);
+        }
+
+        uint32_t parent;       // the root is its own parent
+        uint32_t first_child, child_count;
+        uint32_t first_file, file_count;
+
+    private:
+        friend class ISArchiveV3;
+        std::string_view m_path;
+        uint32_t m_name_offset;
+    };
+
+    static std::tm dosDateTime(uint32_t datetime);
+    // Sanity check for a header followed by `available` bytes of archive data.
+    static bool isValidHeader(const Header& hdr, uint64_t available);
+
     const std::vector<File>& files() const;
-    bool exists(const std::string& full_path) const;
-    std::vector<uint8_t> decompress(const std::string& full_path);
+    const std::vector<Directory>& directories() const;
+    const Directory& root() const {
+        return m_directories.front();
+    }
+    // nullptr if there is no such file or directory
+    const File* file(std::string_view full_path) const;
+    const Directory* directoryByPath(std::string_view full_path) const;
+    // All files in `dir` and its descendants, depth-first.
+    std::vector<const File*> subtree(const Directory& dir) const;
+    bool exists(std::string_view full_path) const;
+    std::vector<uint8_t> decompress(std::string_view full_path);
+    // The stored (possibly compressed) bytes of an entry.
+    std::vector<uint8_t> readCompressed(std::string_view full_path);
+    std::vector<uint8_t> readCompressed(const File& file);
+    // Decompress bytes previously returned by readCompressed(file).
+    std::vector<uint8_t> decode(const File& file, std::vector<uint8_t> compressed);
+
+    // Variants that fill caller-owned buffers and reuse their capacity, so
+    // that pooled buffers (see BufferPool) make decoding allocation-free.
+    // `input` receives the stored bytes if the archive is not mapped.
+    void decompress(const File& file, std::vector<uint8_t>& out, std::vector<uint8_t>& input);
+    void readCompressed(const File& file, std::vector<uint8_t>& out);
+    void decode(const File& file, const std::vector<uint8_t>& compressed, std::vector<uint8_t>& out);
+
+    // Receives consecutive pieces of decompressed data. Returning false stops
+    // decompression.
+    using Sink = std::function<bool(const uint8_t* data, size_t len)>;
+    // Decompress an entry piece by piece, without holding all of its output.
+    void decompress(const File& file, const Sink& sink);
+
+    // Decode an entry once, taking a decoder checkpoint every `interval`
+    // output bytes. Uncompressed entries need none.
+    SeekIndex buildSeekIndex(const File& file, uint32_t interval = 256 * 1024);
+    // Up to `len` bytes of an entry's contents from `offset` on. Compressed
+    // entries are decoded from the closest checkpoint in `index` before
+    // `offset`, or from their start without one.
+    std::vector<uint8_t> readAt(const File& file, uint64_t offset, size_t len,
+            const SeekIndex* index = nullptr);
     std::filesystem::path path() const {
         return m_path;
     }
+    // Whether entries are read straight from a memory mapping.
+    bool mapped() const {
+        return bool(m_map);
+    }
     Header header() const {
         return hdr;
     }
+    uint64_t baseOffset() const {
+        return m_base_offset;
+    }
+    Stats* stats() const {
+        return m_stats;
+    }
+
+    // Bounds on the work a single archive can cause. Decoding stops with an
+    // exception as soon as one is exceeded; 0 disables a limit. Independent
+    // of these, no entry may decode past its uncompressed_size.
+    class Limits {
+    public:
+        uint64_t max_entry_size = 0;   // decoded bytes per entry
+        uint64_t max_total_size = 0;   // decoded bytes of all entries together
+        uint32_t max_ratio = 0;        // uncompressed_size / compressed_size
+        std::chrono::milliseconds max_time{0}; // decoding time per entry
+    };
+    void setLimits(const Limits& limits) {
+        m_limits = limits;
+    }
+    const Limits& limits() const {
+        return m_limits;
+    }
+    // Throws if `file` is refused by the limits on its TOC sizes. Checked
+    // before any of its bytes are read.
+    void checkLimits(const File& file) const;
 
 protected:
+    // Lets the TOC parser read a mapped archive through the same std::istream.
+    class MemoryBuf : public std::streambuf {
+    public:
+        MemoryBuf(const uint8_t* data, size_t size);
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+        pos_type seekpos(pos_type pos, std::ios_base::openmode which) override;
+    };
+
+    void parse(uint64_t file_size);
+    void buildTree(const std::vector<std::string_view>& records, std::vector<uint32_t>& file_records);
+    void buildIndex();
+    // `length` stored bytes of `file` from `begin` on. Points into the
+    // mapping, or into `buf` after reading them.
+    const uint8_t* storedBytes(const File& file, uint64_t begin, uint64_t length,
+            std::vector<uint8_t>& buf);
+    std::vector<uint8_t> decodeRange(const File& file, const uint8_t* data, size_t size);
+    void decodeRange(const File& file, const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+    void decodeRange(const File& file, const uint8_t* data, size_t size, const Sink& sink);
     template<class T> T read();
-    std::string readString8();
     std::string readString16();
-    bool isValidName(const std::string& name) const;
-    const File* fileByPath(const std::string& full_path) const;
+    bool isValidName(std::string_view name) const;
+    const File* fileByPath(std::string_view full_path) const;
 
     const std::filesystem::path m_path;
-    std::ifstream fin;
+    const uint64_t m_base_offset;
+    Stats* m_stats;
+    Limits m_limits;
+    std::atomic<uint64_t> m_decoded{0}; // bytes decoded, for max_total_size
+    std::shared_ptr<const MappedFile> m_map;
+    std::filebuf m_filebuf;
+    std::unique_ptr<MemoryBuf> m_membuf;
+    std::istream fin;
+    StringArena m_strings;
     std::vector<File> m_files;
+    // Open-addressing hash table over full paths: m_files index + 1, or 0.
+    std::vector<uint32_t> m_index;
+    std::vector<Directory> m_directories;
+    std::unordered_map<std::string_view, size_t> m_directory_index; // full_path -> m_directories
     Header hdr;
 };
 
@@ -0,0 +1,115 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Cost of keeping an item in an LRUCache: one unit per item by default, the
+// number of bytes for buffers.
+template<class T> struct LRUCost {
+    static uint64_t of(const T&) {
+        return 1;
+    }
+};
+template<> struct LRUCost<const std::vector<uint8_t>> {
+    static uint64_t of(const std::vector<uint8_t>& v) {
+        return v.size();
+    }
+};
+
+// Thread-safe least-recently-used cache of shared objects, bounded by their
+// total cost: bytes for decoded buffers, item count otherwise.
+template<class Key, class T = const std::vector<uint8_t>> class LRUCache {
+public:
+    using Value = std::shared_ptr<T>;
+
+    LRUCache(uint64_t capacity)
+        : m_capacity(capacity)
+    {}
+
+    Value get(const Key& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            m_misses++;
+            return nullptr;
+        }
+        m_items.splice(m_items.begin(), m_items, it->second);
+        m_hits++;
+        return it->second->second;
+    }
+
+    // Insert `value`, evicting the least recently used items to make room.
+    // Values costlier than the whole cache are not retained.
+    void put(const Key& key, Value value) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_cost -= LRUCost<T>::of(*it->second->second);
+            m_items.erase(it->second);
+            m_index.erase(it);
+        }
+        uint64_t cost = LRUCost<T>::of(*value);
+        if (cost > m_capacity) {
+            return;
+        }
+        while (!m_items.empty() && m_cost + cost > m_capacity) {
+            m_cost -= LRUCost<T>::of(*m_items.back().second);
+            m_index.erase(m_items.back().first);
+            m_items.pop_back();
+        }
+        m_items.emplace_front(key, std::move(value));
+        m_index[key] = m_items.begin();
+        m_cost += cost;
+    }
+
+    uint64_t capacity() const {
+        return m_capacity;
+    }
+    uint64_t cost() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_cost;
+    }
+    size_t count() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+    uint64_t hits() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_hits;
+    }
+    uint64_t misses() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_misses;
+    }
+
+protected:
+    using Item = std::pair<Key, Value>;
+
+    const uint64_t m_capacity;
+    mutable std::mutex m_mutex;
+    std::list<Item> m_items; // most recently used first
+    std::unordered_map<Key, typename std::list<Item>::iterator> m_index;
+    uint64_t m_cost = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
@@ -0,0 +1,107 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "MappedFile.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& apath)
+    : m_path(apath)
+{
+#ifndef _WIN32
+    int fd = ::open(apath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::ostringstream os;
+        os << "Cannot open file: " << apath;
+        throw std::runtime_error(os.str());
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        std::ostringstream os;
+        os << "Cannot stat file: " << apath;
+        throw std::runtime_error(os.str());
+    }
+    m_size = size_t(st.st_size);
+    if (m_size > 0) {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            ::close(fd);
+            std::ostringstream os;
+            os << "Cannot map file: " << apath;
+            throw std::runtime_error(os.str());
+        }
+        m_data = static_cast<const uint8_t*>(p);
+        m_mapped = true;
+    }
+    ::close(fd);
+#else
+    std::ifstream fin(apath, std::ios::in | std::ios::binary);
+    if (!fin.is_open()) {
+        std::ostringstream os;
+        os << "Cannot open file: " << apath;
+        throw std::runtime_error(os.str());
+    }
+    m_buffer.resize(std::filesystem::file_size(apath));
+    fin.read(reinterpret_cast<char*>(m_buffer.data()), std::streamsize(m_buffer.size()));
+    if (fin.fail()) {
+        throw std::runtime_error("Read failed");
+    }
+    m_data = m_buffer.data();
+    m_size = m_buffer.size();
+#endif
+}
+
+#ifndef _WIN32
+MappedFile::MappedFile(int fd)
+    : m_path("/dev/fd/" + std::to_string(fd))
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        throw std::runtime_error("Cannot stat file descriptor");
+    }
+    m_size = size_t(st.st_size);
+    if (m_size > 0) {
+        void* p = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            throw std::runtime_error("Cannot map file descriptor");
+        }
+        m_data = static_cast<const uint8_t*>(p);
+        m_mapped = true;
+    }
+}
+#endif
+
+MappedFile::MappedFile(const uint8_t* data, size_t size)
+    : m_path("<memory>"), m_data(data), m_size(size)
+{
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (m_mapped) {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+#endif
+}
@@ -0,0 +1,54 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <filesystem>
+#include <cstdint>
+#include <vector>
+
+// Read-only view of a whole file. Uses mmap() where available and falls back
+// to reading the file into memory elsewhere.
+class MappedFile {
+public:
+    MappedFile(const std::filesystem::path& apath);
+#ifndef _WIN32
+    // Map the whole file behind `fd`. The descriptor is not closed.
+    explicit MappedFile(int fd);
+#endif
+    // Borrow `size` bytes at `data`, which must outlive this object.
+    MappedFile(const uint8_t* data, size_t size);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const {
+        return m_data;
+    }
+    size_t size() const {
+        return m_size;
+    }
+    std::filesystem::path path() const {
+        return m_path;
+    }
+
+protected:
+    const std::filesystem::path m_path;
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+    bool m_mapped = false;
+    std::vector<uint8_t> m_buffer; // fallback storage without mmap()
+};
@@ -0,0 +1,86 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+// Helpers for the single-file tables that are mapped and read in place
+// (Catalog, PackArchive). Their contents are untrusted: every offset is
+// checked once at open, and hash chains are walked with a bound.
+
+// Whether `count` items of `item` bytes starting at `offset` lie within
+// `size` bytes, without overflow.
+inline bool tableFits(uint64_t size, uint64_t offset, uint64_t count, uint64_t item) {
+    return offset <= size && count <= (size - offset) / item;
+}
+
+// Counts the steps of a walk along a hash chain. A chain visits each of
+// `entry_count` entries at most once, unless the file has a cycle, in which
+// case step() throws `error`.
+class ChainGuard {
+public:
+    ChainGuard(uint32_t entry_count, const char* error)
+        : m_limit(entry_count), m_error(error)
+    {}
+
+    void step() {
+        if (m_steps++ == m_limit) {
+            throw std::runtime_error(m_error);
+        }
+    }
+
+private:
+    uint32_t m_steps = 0;
+    const uint32_t m_limit;
+    const char* m_error;
+};
+
+// Create `path` by calling `write(std::ofstream&)` on a file next to it and
+// renaming that into place, so that readers never observe a half-written
+// file. `kind` names the file in errors. The temporary file is removed if
+// writing fails.
+template<class Write>
+void writeTableFile(const std::filesystem::path& path, const char* kind, Write write) {
+    std::filesystem::path tmp = path;
+    tmp += ".tmp";
+    try {
+        std::ofstream fout(tmp, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!fout.is_open()) {
+            std::ostringstream os;
+            os << "Cannot create " << kind << ": " << tmp;
+            throw std::runtime_error(os.str());
+        }
+        write(fout);
+        fout.close();
+        if (fout.fail()) {
+            std::ostringstream os;
+            os << "Could not write to: " << tmp;
+            throw std::runtime_error(os.str());
+        }
+    } catch (...) {
+        std::error_code ec;
+        std::filesystem::remove(tmp, ec);
+        throw;
+    }
+    std::filesystem::rename(tmp, path);
+}
@@ -0,0 +1,60 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+// Admission control for concurrent work that needs memory. acquire() blocks
+// until the requested bytes fit under the limit together with everything
+// acquired and not yet released. A request larger than the whole limit is
+// admitted once nothing else is in flight, so that it cannot wait forever.
+class MemoryBudget {
+public:
+    explicit MemoryBudget(uint64_t limit)
+        : m_limit(limit)
+    {}
+
+    // Returns the bytes in flight including this request.
+    uint64_t acquire(uint64_t bytes) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            return m_in_flight == 0 || m_in_flight + bytes <= m_limit;
+        });
+        m_in_flight += bytes;
+        return m_in_flight;
+    }
+
+    void release(uint64_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_in_flight -= bytes;
+        }
+        m_cv.notify_all();
+    }
+
+    uint64_t limit() const {
+        return m_limit;
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    const uint64_t m_limit;
+    uint64_t m_in_flight = 0;
+};
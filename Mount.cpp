@@ -0,0 +1,180 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#define FUSE_USE_VERSION 31
+#include "Mount.h"
+#include "LRUCache.h"
+#include "SeekIndex.h"
+#include <fuse.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <string>
+
+namespace {
+
+// Seek indexes kept for entries too large for the cache.
+const size_t MAX_INDEXES = 64;
+
+class MountedArchive {
+public:
+    MountedArchive(ISArchiveV3& archive, uint64_t cache_bytes)
+        : archive(archive), cache(cache_bytes), indexes(MAX_INDEXES)
+    {}
+
+    ISArchiveV3& archive;
+    LRUCache<const ISArchiveV3::File*> cache;
+    LRUCache<const ISArchiveV3::File*, const SeekIndex> indexes;
+};
+
+MountedArchive* mounted() {
+    return static_cast<MountedArchive*>(fuse_get_context()->private_data);
+}
+
+// "/DIR/FILE" -> "DIR\FILE"
+std::string archivePath(const char* path) {
+    std::string p(path[0] == '/' ? path + 1 : path);
+    std::replace(p.begin(), p.end(), '/', '\\');
+    return p;
+}
+
+int fs_getattr(const char* path, struct stat* st, struct fuse_file_info*) {
+    MountedArchive* m = mounted();
+    std::string ap = archivePath(path);
+    memset(st, 0, sizeof(*st));
+    if (const auto* dir = m->archive.directoryByPath(ap)) {
+        st->st_mode = S_IFDIR | 0555;
+        st->st_nlink = 2 + dir->child_count;
+        return 0;
+    }
+    const auto* file = m->archive.file(ap);
+    if (file == nullptr) {
+        return -ENOENT;
+    }
+    std::tm tm = file->tm();
+    st->st_mode = S_IFREG | 0444;
+    st->st_nlink = 1;
+    st->st_size = off_t(file->uncompressed_size);
+    st->st_mtime = st->st_ctime = st->st_atime = mktime(&tm);
+    return 0;
+}
+
+int fs_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t,
+        struct fuse_file_info*, enum fuse_readdir_flags)
+{
+    MountedArchive* m = mounted();
+    const auto* dir = m->archive.directoryByPath(archivePath(path));
+    if (dir == nullptr) {
+        return -ENOENT;
+    }
+    filler(buf, ".", nullptr, 0, fuse_fill_dir_flags(0));
+    filler(buf, "..", nullptr, 0, fuse_fill_dir_flags(0));
+    const auto& dirs = m->archive.directories();
+    for (uint32_t i = 0; i < dir->child_count; i++) {
+        filler(buf, dirs[dir->first_child + i].name().data(), nullptr, 0, fuse_fill_dir_flags(0));
+    }
+    const auto& files = m->archive.files();
+    for (uint32_t i = 0; i < dir->file_count; i++) {
+        filler(buf, files[dir->first_file + i].name().data(), nullptr, 0, fuse_fill_dir_flags(0));
+    }
+    return 0;
+}
+
+int fs_open(const char* path, struct fuse_file_info* fi) {
+    MountedArchive* m = mounted();
+    if (m->archive.file(archivePath(path)) == nullptr) {
+        return -ENOENT;
+    }
+    if ((fi->flags & O_ACCMODE) != O_RDONLY) {
+        return -EROFS;
+    }
+    fi->keep_cache = 1; // contents never change
+    return 0;
+}
+
+int fs_read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info*) {
+    MountedArchive* m = mounted();
+    const auto* file = m->archive.file(archivePath(path));
+    if (file == nullptr) {
+        return -ENOENT;
+    }
+    // Stored entries are read in place. Compressed entries that the cache
+    // cannot hold are decoded from the closest checkpoint, instead of from
+    // their start on every read.
+    bool stored = file->attrib & ISArchiveV3::File::Attributes::UNCOMPRESSED;
+    if (stored || file->uncompressed_size > m->cache.capacity()) {
+        try {
+            auto index = stored ? nullptr : m->indexes.get(file);
+            if (!stored && !index) {
+                index = std::make_shared<const SeekIndex>(m->archive.buildSeekIndex(*file));
+                m->indexes.put(file, index);
+            }
+            auto data = m->archive.readAt(*file, uint64_t(std::max<off_t>(offset, 0)), size, index.get());
+            memcpy(buf, data.data(), data.size());
+            return int(data.size());
+        } catch (const std::exception&) {
+            return -EIO;
+        }
+    }
+    auto contents = m->cache.get(file);
+    if (!contents) {
+        try {
+            contents = std::make_shared<const std::vector<uint8_t>>(
+                    m->archive.decompress(file->fullPath()));
+        } catch (const std::exception&) {
+            return -EIO;
+        }
+        m->cache.put(file, contents);
+    }
+    if (offset < 0 || uint64_t(offset) >= contents->size()) {
+        return 0;
+    }
+    size = std::min<size_t>(size, contents->size() - size_t(offset));
+    memcpy(buf, contents->data() + offset, size);
+    return int(size);
+}
+
+} // namespace
+
+int mountArchive(ISArchiveV3& archive, const std::filesystem::path& mountpoint,
+        uint64_t cache_bytes, bool foreground)
+{
+    MountedArchive m(archive, cache_bytes);
+
+    struct fuse_operations ops;
+    memset(&ops, 0, sizeof(ops));
+    ops.getattr = fs_getattr;
+    ops.readdir = fs_readdir;
+    ops.open = fs_open;
+    ops.read = fs_read;
+
+    std::string mp = mountpoint.string();
+    std::vector<char*> argv = {
+        const_cast<char*>("unshieldv3"),
+        const_cast<char*>(mp.c_str()),
+        const_cast<char*>("-o"),
+        const_cast<char*>("ro"),
+        const_cast<char*>("-o"),
+        const_cast<char*>("fsname=unshieldv3"),
+    };
+    if (foreground) {
+        argv.push_back(const_cast<char*>("-f"));
+    }
+    return fuse_main(int(argv.size()), argv.data(), &ops, &m);
+}
@@ -0,0 +1,27 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "ISArchiveV3.h"
+#include <filesystem>
+
+// Serve `archive` as a read-only FUSE file system at `mountpoint` until it is
+// unmounted. Entries are decoded on first read and kept in an LRU cache of at
+// most `cache_bytes`. `archive` should be memory-mapped so that reads can be
+// served from several threads. Returns the exit status of the FUSE loop.
+int mountArchive(ISArchiveV3& archive, const std::filesystem::path& mountpoint,
+        uint64_t cache_bytes, bool foreground);
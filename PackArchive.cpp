@@ -0,0 +1,188 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "PackArchive.h"
+#include "BufferPool.h"
+#include "Hash.h"
+#include "ISArchiveV3.h"
+#include "MappedTable.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+static const char PACK_MAGIC[8] = {'U', 'V', '3', 'P', 'A', 'C', 'K', 0};
+
+// Contents of at least PAGE_MIN bytes start on a page, smaller ones on a
+// cache line.
+static const uint64_t LINE = 64;
+static const uint64_t PAGE = 4096;
+static const uint64_t PAGE_MIN = 64 * 1024;
+
+static uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) & ~(alignment - 1);
+}
+
+PackArchive::PackArchive(const std::filesystem::path& ppath)
+    : m_file(ppath)
+{
+    const uint8_t* base = m_file.data();
+    uint64_t size = m_file.size();
+    if (size < sizeof(Header)) {
+        throw std::runtime_error("Pack truncated");
+    }
+    m_header = reinterpret_cast<const Header*>(base);
+    if (memcmp(m_header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0) {
+        throw std::runtime_error("Not a pack file");
+    }
+    if (m_header->version != VERSION) {
+        throw std::runtime_error("Unsupported pack version");
+    }
+    if (!tableFits(size, m_header->entries_offset, m_header->entry_count, sizeof(Entry))
+            || !tableFits(size, m_header->buckets_offset, m_header->bucket_count, sizeof(uint32_t))
+            || !tableFits(size, m_header->strings_offset, m_header->strings_size, 1)
+            || !tableFits(size, m_header->data_offset, m_header->data_size, 1)
+            || m_header->bucket_count == 0
+            || (m_header->bucket_count & (m_header->bucket_count - 1)) != 0) {
+        throw std::runtime_error("Pack corrupt");
+    }
+    m_entries = reinterpret_cast<const Entry*>(base + m_header->entries_offset);
+    m_buckets = reinterpret_cast<const uint32_t*>(base + m_header->buckets_offset);
+    m_strings = reinterpret_cast<const char*>(base + m_header->strings_offset);
+    // data() and fullPath() hand out views without further checks, and
+    // path() must stay below the directory an entry is extracted to.
+    uint64_t data_end = m_header->data_offset + m_header->data_size;
+    for (uint32_t i = 0; i < m_header->entry_count; i++) {
+        const Entry& e = m_entries[i];
+        if (e.data_offset < m_header->data_offset
+                || !tableFits(data_end, e.data_offset, e.size, 1)
+                || !tableFits(m_header->strings_size, e.path_offset, e.path_length, 1)
+                || e.name_length > e.path_length) {
+            throw std::runtime_error("Pack corrupt");
+        }
+        std::string_view p = fullPath(e);
+        if (p.empty() || p[0] == '\\' || p[0] == '/'
+                || p.find("..\\") != std::string_view::npos
+                || p.find("../") != std::string_view::npos) {
+            throw std::runtime_error("Pack corrupt");
+        }
+    }
+}
+
+bool PackArchive::isPack(const std::filesystem::path& ppath) {
+    std::ifstream fin(ppath, std::ios::in | std::ios::binary);
+    char magic[sizeof(PACK_MAGIC)];
+    return fin.read(magic, sizeof(magic)) && memcmp(magic, PACK_MAGIC, sizeof(magic)) == 0;
+}
+
+const PackArchive::Entry* PackArchive::file(std::string_view full_path) const {
+    uint32_t b = uint32_t(fnv1a64(full_path.data(), full_path.size())) & (m_header->bucket_count - 1);
+    ChainGuard guard(m_header->entry_count, "Pack corrupt");
+    for (uint32_t i = m_buckets[b]; i != NONE && i < m_header->entry_count; i = m_entries[i].next) {
+        guard.step();
+        if (fullPath(m_entries[i]) == full_path) {
+            return &m_entries[i];
+        }
+    }
+    return nullptr;
+}
+
+std::filesystem::path PackArchive::path(const Entry& e) const {
+    std::string p(fullPath(e));
+    std::replace(p.begin(), p.end(), '\\', char(std::filesystem::path::preferred_separator));
+    return std::filesystem::path(p);
+}
+
+std::tm PackArchive::tm(const Entry& e) const {
+    return ISArchiveV3::dosDateTime(e.datetime);
+}
+
+void PackArchive::build(ISArchiveV3& archive, const std::filesystem::path& ppath) {
+    const auto& files = archive.files();
+    if (files.size() >= NONE) {
+        throw std::runtime_error("Too many entries for one pack");
+    }
+    std::vector<Entry> entries(files.size());
+    std::string strings;
+    for (size_t i = 0; i < files.size(); i++) {
+        const ISArchiveV3::File& f = files[i];
+        Entry& e = entries[i];
+        e = {};
+        e.path_offset = strings.size();
+        e.path_length = uint32_t(f.fullPath().size());
+        e.compressed_size = f.compressed_size;
+        e.datetime = f.datetime;
+        e.attrib = f.attrib;
+        e.name_length = uint8_t(f.name().size());
+        strings.append(f.fullPath());
+    }
+
+    uint32_t bucket_count = 16;
+    while (bucket_count < entries.size() * 2) {
+        bucket_count <<= 1;
+    }
+    // Chains are built back to front, so that the first of several entries
+    // with the same path is found first, as in ISArchiveV3.
+    std::vector<uint32_t> buckets(bucket_count, NONE);
+    for (size_t i = entries.size(); i > 0; i--) {
+        Entry& e = entries[i - 1];
+        std::string_view path(strings.data() + e.path_offset, e.path_length);
+        uint32_t b = uint32_t(fnv1a64(path.data(), path.size())) & (bucket_count - 1);
+        e.next = buckets[b];
+        buckets[b] = uint32_t(i - 1);
+    }
+
+    Header hdr = {};
+    memcpy(hdr.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    hdr.version = VERSION;
+    hdr.entry_count = uint32_t(entries.size());
+    hdr.bucket_count = bucket_count;
+    hdr.datetime = archive.header().datetime;
+    hdr.strings_size = strings.size();
+    hdr.entries_offset = alignUp(sizeof(Header), 8);
+    hdr.buckets_offset = alignUp(hdr.entries_offset + entries.size() * sizeof(Entry), 8);
+    hdr.strings_offset = alignUp(hdr.buckets_offset + buckets.size() * sizeof(uint32_t), 8);
+    hdr.data_offset = alignUp(hdr.strings_offset + strings.size(), PAGE);
+
+    writeTableFile(ppath, "pack", [&](std::ofstream& fout) {
+        // Contents first, since their sizes are known only after decoding.
+        BufferPool pool;
+        uint64_t offset = hdr.data_offset;
+        for (size_t i = 0; i < files.size(); i++) {
+            auto contents = pool.get(files[i].decodedSizeHint());
+            auto input = pool.get(archive.mapped() ? 0 : files[i].compressed_size);
+            archive.decompress(files[i], *contents, *input);
+            offset = alignUp(offset, contents->size() >= PAGE_MIN ? PAGE : LINE);
+            entries[i].data_offset = offset;
+            entries[i].size = uint32_t(contents->size());
+            fout.seekp(std::streamoff(offset), std::ios::beg);
+            fout.write(reinterpret_cast<const char*>(contents->data()), std::streamsize(contents->size()));
+            offset += contents->size();
+        }
+        hdr.data_size = offset - hdr.data_offset;
+
+        fout.seekp(0, std::ios::beg);
+        fout.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+        fout.seekp(std::streamoff(hdr.entries_offset), std::ios::beg);
+        fout.write(reinterpret_cast<const char*>(entries.data()), std::streamsize(entries.size() * sizeof(Entry)));
+        fout.seekp(std::streamoff(hdr.buckets_offset), std::ios::beg);
+        fout.write(reinterpret_cast<const char*>(buckets.data()), std::streamsize(buckets.size() * sizeof(uint32_t)));
+        fout.seekp(std::streamoff(hdr.strings_offset), std::ios::beg);
+        fout.write(strings.data(), std::streamsize(strings.size()));
+    });
+}
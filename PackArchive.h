@@ -0,0 +1,109 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "MappedFile.h"
+#include <ctime>
+#include <filesystem>
+#include <string_view>
+
+class ISArchiveV3;
+
+// An archive decoded once into an uncompressed container, for archives that
+// are read too often to pay for decoding each time.
+//
+// A pack is a single little-endian file that is mapped into memory and read
+// in place: a header, a table of entries in archive order, a hash table over
+// full paths, a pool of path strings and the entries' contents. Contents
+// start on 64-byte boundaries, and those of 64 KB or more on page
+// boundaries, so data() hands out aligned views into the mapping.
+class PackArchive {
+public:
+    PackArchive(const std::filesystem::path& ppath);
+
+    class Header {
+    public:
+        char magic[8];          // "UV3PACK\0"
+        uint32_t version;
+        uint32_t entry_count;
+        uint32_t bucket_count;  // power of two
+        uint32_t datetime;      // of the source archive
+        uint64_t strings_size;
+        uint64_t entries_offset;
+        uint64_t buckets_offset;
+        uint64_t strings_offset;
+        uint64_t data_offset;
+        uint64_t data_size;
+    };
+
+    class Entry {
+    public:
+        uint64_t data_offset;   // from the start of the file
+        uint64_t path_offset;   // full path, directory separator: \ (Windows)
+        uint32_t path_length;
+        uint32_t size;
+        uint32_t compressed_size; // in the source archive
+        uint32_t datetime;
+        uint32_t next;          // next entry in the same hash bucket
+        uint8_t attrib;         // as in the source archive
+        uint8_t name_length;    // file name = last name_length bytes of path
+        uint16_t u1;
+    };
+
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t NONE = 0xffffffff;
+
+    // Decode every entry of `archive` and write the pack to `ppath`.
+    static void build(ISArchiveV3& archive, const std::filesystem::path& ppath);
+    // Whether `ppath` starts like a pack.
+    static bool isPack(const std::filesystem::path& ppath);
+
+    const Header& header() const {
+        return *m_header;
+    }
+    uint32_t entryCount() const {
+        return m_header->entry_count;
+    }
+    const Entry& entry(uint32_t index) const {
+        return m_entries[index];
+    }
+    // nullptr if there is no such entry
+    const Entry* file(std::string_view full_path) const;
+    bool exists(std::string_view full_path) const {
+        return file(full_path) != nullptr;
+    }
+    std::string_view fullPath(const Entry& e) const {
+        return std::string_view(m_strings + e.path_offset, e.path_length);
+    }
+    std::string_view name(const Entry& e) const {
+        return fullPath(e).substr(e.path_length - e.name_length);
+    }
+    // The full path with native separators, relative to a destination.
+    std::filesystem::path path(const Entry& e) const;
+    // The entry's contents, e.size bytes, valid while the pack is open.
+    const uint8_t* data(const Entry& e) const {
+        return m_file.data() + e.data_offset;
+    }
+    std::tm tm(const Entry& e) const;
+
+protected:
+    MappedFile m_file;
+    const Header* m_header;
+    const Entry* m_entries;
+    const uint32_t* m_buckets;
+    const char* m_strings;
+};
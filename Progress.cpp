@@ -0,0 +1,191 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Progress.h"
+#include <cstdio>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Buffered output is written once it grows past this, or on the next tick.
+static const size_t FLUSH_SIZE = 64 * 1024;
+static const std::chrono::milliseconds TICK(250);
+
+static bool isTerminal(const std::ostream& os) {
+#ifdef _WIN32
+    return &os == &std::cerr && _isatty(2);
+#else
+    return (&os == &std::cerr && isatty(2)) || (&os == &std::cout && isatty(1));
+#endif
+}
+
+// `n` right-aligned in `width` columns.
+static void appendNumber(std::string& s, uint64_t n, size_t width) {
+    std::string digits = std::to_string(n);
+    if (digits.size() < width) {
+        s.append(width - digits.size(), ' ');
+    }
+    s += digits;
+}
+
+static void appendJsonString(std::string& s, std::string_view text) {
+    s += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            s += '\\';
+            s += c;
+        } else if (uint8_t(c) < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", unsigned(uint8_t(c)));
+            s += esc;
+        } else {
+            s += c;
+        }
+    }
+    s += '"';
+}
+
+Progress::Progress(Mode mode, std::ostream& out, std::ostream& status)
+    : m_mode(mode), m_out(out), m_status(status), m_terminal(isTerminal(status)),
+      m_start(std::chrono::steady_clock::now())
+{}
+
+Progress::~Progress() {
+    finish();
+}
+
+void Progress::start(uint64_t entries, uint64_t bytes) {
+    m_total_entries = entries;
+    m_total_bytes = bytes;
+    m_start = std::chrono::steady_clock::now();
+    if (m_mode != Mode::QUIET && !m_timer.joinable()) {
+        m_timer = std::thread([this]() { run(); });
+    }
+}
+
+void Progress::entry(std::string_view path, uint64_t compressed_size, uint64_t size,
+        Source source, std::string_view origin)
+{
+    m_entries.fetch_add(1, std::memory_order_relaxed);
+    m_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (m_mode != Mode::FILES && m_mode != Mode::JSON) {
+        return;
+    }
+    std::string line;
+    if (m_mode == Mode::FILES) {
+        line += path;
+        line += "\n      Compressed size: ";
+        appendNumber(line, compressed_size, 10);
+        line += "\n    Uncompressed size: ";
+        appendNumber(line, size, 10);
+        line += '\n';
+        if (source == Source::DUPLICATE) {
+            line += "         Duplicate of: ";
+            line += origin;
+            line += '\n';
+        } else if (source == Source::STORE) {
+            line += "           From store: ";
+            line += origin;
+            line += '\n';
+        }
+    } else {
+        line += "{\"path\": ";
+        appendJsonString(line, path);
+        line += ", \"compressed_size\": " + std::to_string(compressed_size);
+        line += ", \"size\": " + std::to_string(size);
+        if (source == Source::DUPLICATE) {
+            line += ", \"duplicate_of\": ";
+            appendJsonString(line, origin);
+        } else if (source == Source::STORE) {
+            line += ", \"store_key\": ";
+            appendJsonString(line, origin);
+        }
+        line += "}\n";
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffer += line;
+    if (m_buffer.size() >= FLUSH_SIZE) {
+        flush();
+    }
+}
+
+void Progress::finish() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cv.notify_all();
+    bool started = m_timer.joinable();
+    if (started) {
+        m_timer.join();
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    flush();
+    if (started && m_mode == Mode::SUMMARY) {
+        printStatus(true);
+    }
+}
+
+void Progress::run() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_cv.wait_for(lock, TICK, [this]() { return m_stopping; })) {
+        flush();
+        if (m_mode == Mode::SUMMARY && m_terminal) {
+            printStatus(false);
+        }
+    }
+}
+
+// Requires m_mutex.
+void Progress::flush() {
+    if (!m_buffer.empty()) {
+        m_out.write(m_buffer.data(), std::streamsize(m_buffer.size()));
+        m_out.flush();
+        m_buffer.clear();
+    }
+}
+
+// Requires m_mutex.
+void Progress::printStatus(bool final) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+    uint64_t entries = m_entries.load();
+    uint64_t bytes = m_bytes.load();
+    double rate = seconds > 0 ? bytes / seconds : 0;
+    char line[160];
+    if (final) {
+        snprintf(line, sizeof(line), "%llu entries, %.1f MB in %.2f s (%.1f MB/s)",
+                (unsigned long long)entries, bytes / 1e6, seconds, rate / 1e6);
+    } else {
+        uint64_t remaining = m_total_bytes > bytes ? m_total_bytes - bytes : 0;
+        unsigned eta = rate > 0 ? unsigned(remaining / rate + 0.5) : 0;
+        snprintf(line, sizeof(line), "%llu/%llu entries, %.1f/%.1f MB, %.1f MB/s, ETA %u:%02u",
+                (unsigned long long)entries, (unsigned long long)m_total_entries,
+                bytes / 1e6, m_total_bytes / 1e6, rate / 1e6, eta / 60, eta % 60);
+    }
+    // Overwrite the previous status line on terminals.
+    if (m_terminal) {
+        m_status << "\r\033[K";
+    }
+    m_status << line;
+    if (final || !m_terminal) {
+        m_status << "\n";
+    }
+    m_status.flush();
+}
@@ -0,0 +1,90 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "ISArchiveV3.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+// Reports the entries of an extraction. Workers only append to a buffer or
+// bump counters; a timer thread writes the buffer out and, in SUMMARY mode,
+// refreshes a status line with entries, bytes, throughput and ETA on
+// terminals. Thread-safe.
+class Progress {
+public:
+    enum class Mode {
+        QUIET,      // nothing
+        SUMMARY,    // status line and a final summary on `status`
+        FILES,      // path and sizes of every entry on `out`
+        JSON        // one JSON object per entry on `out`
+    };
+
+    // How an entry was materialized.
+    enum class Source {
+        DECODED,
+        DUPLICATE,  // linked to an earlier entry
+        STORE       // fetched from a blob store
+    };
+
+    Progress(Mode mode, std::ostream& out, std::ostream& status);
+    ~Progress();
+    Progress(const Progress&) = delete;
+    Progress& operator=(const Progress&) = delete;
+
+    // Start the timer for `entries` entries of `bytes` bytes in total.
+    void start(uint64_t entries, uint64_t bytes);
+    // Report an entry of `size` decoded bytes. `origin` names the earlier
+    // entry (DUPLICATE) or the blob (STORE).
+    void entry(const ISArchiveV3::File& file, uint64_t size, Source source = Source::DECODED,
+            std::string_view origin = {}) {
+        entry(file.fullPath(), file.compressed_size, size, source, origin);
+    }
+    // Report an entry by path, for entries that are not read from an
+    // ISArchiveV3 (packs).
+    void entry(std::string_view path, uint64_t compressed_size, uint64_t size,
+            Source source = Source::DECODED, std::string_view origin = {});
+    // Stop the timer and write out everything reported.
+    void finish();
+
+protected:
+    void run();
+    void flush();
+    void printStatus(bool final);
+
+    const Mode m_mode;
+    std::ostream& m_out;
+    std::ostream& m_status;
+    bool m_terminal;
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::string m_buffer;   // guarded by m_mutex
+    bool m_stopping = false;
+    std::thread m_timer;
+
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_total_entries = 0;
+    uint64_t m_total_bytes = 0;
+    std::atomic<uint64_t> m_entries{0};
+    std::atomic<uint64_t> m_bytes{0};
+};
@@ -0,0 +1,83 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Scanner.h"
+#include "ISArchiveV3.h"
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+static const uint8_t SIGNATURE[8] = {0x13, 0x5D, 0x65, 0x8C, 0x3A, 0x01, 0x02, 0x00};
+
+std::vector<uint64_t> Scanner::findSignatures(const uint8_t* data, size_t size) {
+    std::vector<uint64_t> hits;
+    if (size < sizeof(SIGNATURE)) {
+        return hits;
+    }
+    const size_t last = size - sizeof(SIGNATURE); // last candidate position
+    size_t i = 0;
+
+#if defined(__SSE2__)
+    // Compare 16 candidate positions at once against the first two bytes of
+    // the signature and verify the remaining bytes only for the (rare)
+    // positions where both match.
+    const __m128i first = _mm_set1_epi8(char(SIGNATURE[0]));
+    const __m128i second = _mm_set1_epi8(char(SIGNATURE[1]));
+    for (; i + 16 <= last; i += 16) {
+        __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + 1));
+        unsigned mask = unsigned(_mm_movemask_epi8(
+                _mm_and_si128(_mm_cmpeq_epi8(b0, first), _mm_cmpeq_epi8(b1, second))));
+        while (mask) {
+            unsigned bit = unsigned(__builtin_ctz(mask));
+            if (memcmp(data + i + bit + 2, SIGNATURE + 2, sizeof(SIGNATURE) - 2) == 0) {
+                hits.push_back(i + bit);
+            }
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    while (i <= last) {
+        const void* p = memchr(data + i, SIGNATURE[0], last - i + 1);
+        if (!p) {
+            break;
+        }
+        i = size_t(static_cast<const uint8_t*>(p) - data);
+        if (memcmp(data + i, SIGNATURE, sizeof(SIGNATURE)) == 0) {
+            hits.push_back(i);
+        }
+        i++;
+    }
+    return hits;
+}
+
+std::vector<uint64_t> Scanner::findArchives(const uint8_t* data, size_t size) {
+    std::vector<uint64_t> archives;
+    for (uint64_t offset : findSignatures(data, size)) {
+        ISArchiveV3::Header hdr;
+        if (size - offset <= sizeof(hdr)) {
+            continue;
+        }
+        memcpy(&hdr, data + offset, sizeof(hdr));
+        if (ISArchiveV3::isValidHeader(hdr, size - offset)) {
+            archives.push_back(offset);
+        }
+    }
+    return archives;
+}
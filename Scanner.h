@@ -0,0 +1,34 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+// Locate InstallShield V3 archives embedded in arbitrary data, e.g. disk
+// images, CD dumps or self-extracting executables.
+namespace Scanner {
+
+// Offsets of every occurrence of the archive signature
+// `13 5D 65 8C 3A 01 02 00` in data[0..size).
+std::vector<uint64_t> findSignatures(const uint8_t* data, size_t size);
+
+// Offsets of signatures that are followed by a plausible archive header.
+std::vector<uint64_t> findArchives(const uint8_t* data, size_t size);
+
+}
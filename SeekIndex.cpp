@@ -0,0 +1,132 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "SeekIndex.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static const char MAGIC[8] = {'U', 'V', '3', 'S', 'E', 'E', 'K', '\0'};
+
+SeekIndex::SeekIndex(const ISArchiveV3::File& file, uint32_t interval)
+    : m_interval(interval), m_offset(file.offset),
+      m_compressed_size(file.compressed_size),
+      m_uncompressed_size(file.uncompressed_size), m_datetime(file.datetime)
+{}
+
+const blast_checkpoint* SeekIndex::find(uint64_t position) const {
+    auto it = std::upper_bound(m_checkpoints.begin(), m_checkpoints.end(), position,
+            [](uint64_t pos, const blast_checkpoint& cp) {
+                return pos < cp.out;
+            });
+    return it == m_checkpoints.begin() ? nullptr : &*(it - 1);
+}
+
+bool SeekIndex::matches(const ISArchiveV3::File& file) const {
+    return m_offset == file.offset && m_compressed_size == file.compressed_size
+        && m_uncompressed_size == file.uncompressed_size && m_datetime == file.datetime;
+}
+
+void SeekIndex::save(const std::filesystem::path& ipath) const {
+    std::ofstream fout(ipath, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!fout.is_open()) {
+        std::ostringstream os;
+        os << "Cannot create seek index: " << ipath;
+        throw std::runtime_error(os.str());
+    }
+    Header hdr;
+    memcpy(hdr.magic, MAGIC, sizeof(MAGIC));
+    hdr.version = VERSION;
+    hdr.interval = m_interval;
+    hdr.count = uint32_t(m_checkpoints.size());
+    hdr.offset = m_offset;
+    hdr.compressed_size = m_compressed_size;
+    hdr.uncompressed_size = m_uncompressed_size;
+    hdr.datetime = m_datetime;
+    fout.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    for (const auto& cp : m_checkpoints) {
+        Record r;
+        r.in = uint32_t(cp.in);
+        r.out = uint32_t(cp.out);
+        r.next = uint16_t(cp.next);
+        r.bitbuf = uint8_t(cp.bitbuf);
+        r.bitcnt = uint8_t(cp.bitcnt);
+        r.lit = uint8_t(cp.lit);
+        r.dict = uint8_t(cp.dict);
+        r.first = uint8_t(cp.first);
+        r.u1 = 0;
+        memcpy(r.window, cp.window, sizeof(r.window));
+        fout.write(reinterpret_cast<const char*>(&r), sizeof(r));
+    }
+    if (fout.fail()) {
+        std::ostringstream os;
+        os << "Could not write to: " << ipath;
+        throw std::runtime_error(os.str());
+    }
+}
+
+SeekIndex SeekIndex::load(const std::filesystem::path& ipath) {
+    std::ifstream fin(ipath, std::ios::in | std::ios::binary);
+    if (!fin.is_open()) {
+        std::ostringstream os;
+        os << "Cannot open seek index: " << ipath;
+        throw std::runtime_error(os.str());
+    }
+    Header hdr;
+    fin.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+    if (fin.fail() || memcmp(hdr.magic, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a seek index file");
+    }
+    if (hdr.version != VERSION) {
+        throw std::runtime_error("Unsupported seek index version");
+    }
+    SeekIndex index;
+    index.m_interval = hdr.interval;
+    index.m_offset = hdr.offset;
+    index.m_compressed_size = hdr.compressed_size;
+    index.m_uncompressed_size = hdr.uncompressed_size;
+    index.m_datetime = hdr.datetime;
+    for (uint32_t i = 0; i < hdr.count; i++) {
+        Record r;
+        fin.read(reinterpret_cast<char*>(&r), sizeof(r));
+        if (fin.fail()) {
+            throw std::runtime_error("Seek index truncated");
+        }
+        // A checkpoint must lie inside the entry and hold a valid decoder
+        // state, since blast_resume() trusts it.
+        if (r.in > hdr.compressed_size || r.out > hdr.uncompressed_size
+                || r.next >= sizeof(r.window) || r.bitcnt > 7 || r.bitbuf >> r.bitcnt
+                || r.lit > 1 || r.dict < 4 || r.dict > 6 || r.first > 1
+                || (!index.m_checkpoints.empty() && r.out < index.m_checkpoints.back().out)) {
+            throw std::runtime_error("Seek index corrupt");
+        }
+        blast_checkpoint cp;
+        cp.in = r.in;
+        cp.out = r.out;
+        cp.next = r.next;
+        cp.bitbuf = r.bitbuf;
+        cp.bitcnt = r.bitcnt;
+        cp.lit = r.lit;
+        cp.dict = r.dict;
+        cp.first = r.first;
+        memcpy(cp.window, r.window, sizeof(cp.window));
+        index.m_checkpoints.push_back(cp);
+    }
+    return index;
+}
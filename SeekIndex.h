@@ -0,0 +1,91 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "ISArchiveV3.h"
+#include <filesystem>
+#include <vector>
+extern "C" {
+    #include "blast.h"
+}
+
+// Decoder checkpoints taken while decompressing one entry, roughly every
+// `interval` output bytes. ISArchiveV3::readAt() resumes from the nearest one
+// instead of decoding the entry from its start.
+//
+// Saved indexes are little-endian files: a header followed by one record of
+// 4 KB window plus decoder state per checkpoint.
+class SeekIndex {
+public:
+    class __attribute__ ((packed)) Header {
+    public:
+        char magic[8];          // "UV3SEEK\0"
+        uint32_t version;
+        uint32_t interval;
+        uint32_t count;
+        // the entry the index was built for
+        uint32_t offset;
+        uint32_t compressed_size;
+        uint32_t uncompressed_size;
+        uint32_t datetime;
+    };
+
+    class __attribute__ ((packed)) Record {
+    public:
+        uint32_t in;
+        uint32_t out;
+        uint16_t next;
+        uint8_t bitbuf;
+        uint8_t bitcnt;
+        uint8_t lit;
+        uint8_t dict;
+        uint8_t first;
+        uint8_t u1;
+        uint8_t window[4096];
+    };
+
+    static constexpr uint32_t VERSION = 1;
+
+    SeekIndex() = default;
+    SeekIndex(const ISArchiveV3::File& file, uint32_t interval);
+
+    // Last checkpoint whose output starts at or before `position`, or
+    // nullptr to decode from the start.
+    const blast_checkpoint* find(uint64_t position) const;
+    // Whether the index was built for `file`.
+    bool matches(const ISArchiveV3::File& file) const;
+    void add(const blast_checkpoint& cp) {
+        m_checkpoints.push_back(cp);
+    }
+    size_t size() const {
+        return m_checkpoints.size();
+    }
+    uint32_t interval() const {
+        return m_interval;
+    }
+
+    void save(const std::filesystem::path& ipath) const;
+    static SeekIndex load(const std::filesystem::path& ipath);
+
+private:
+    uint32_t m_interval = 0;
+    uint32_t m_offset = 0;
+    uint32_t m_compressed_size = 0;
+    uint32_t m_uncompressed_size = 0;
+    uint32_t m_datetime = 0;
+    std::vector<blast_checkpoint> m_checkpoints; // ascending output position
+};
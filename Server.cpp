@@ -0,0 +1,274 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Server.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+ArchiveServer::ArchiveServer(const std::filesystem::path& socket_path, unsigned threads,
+        uint64_t cache_bytes, size_t max_archives)
+    : m_socket_path(socket_path), m_pool(threads),
+      m_archives(max_archives), m_entries(cache_bytes)
+{
+}
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= size_t(n);
+    }
+    return true;
+}
+
+void ArchiveServer::run() {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw std::runtime_error(std::string("socket: ") + strerror(errno));
+    }
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::string sp = m_socket_path.string();
+    if (sp.size() >= sizeof(addr.sun_path)) {
+        close(listener);
+        throw std::runtime_error("Socket path too long");
+    }
+    memcpy(addr.sun_path, sp.c_str(), sp.size() + 1);
+
+    // Replace a stale socket left behind by a previous server.
+    struct stat st;
+    if (lstat(sp.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+        unlink(sp.c_str());
+    }
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0
+            || listen(listener, SOMAXCONN) != 0) {
+        std::string error = strerror(errno);
+        close(listener);
+        throw std::runtime_error("Cannot listen on " + sp + ": " + error);
+    }
+
+    if (pipe(m_wake) != 0) {
+        std::string error = strerror(errno);
+        close(listener);
+        throw std::runtime_error("pipe: " + error);
+    }
+    fcntl(m_wake[0], F_SETFL, O_NONBLOCK);
+
+    std::map<int, Connection> connections;
+    auto drop = [&connections](int fd) {
+        close(fd);
+        connections.erase(fd);
+    };
+    std::vector<pollfd> fds;
+    char chunk[4096];
+    while (true) {
+        // Connections with a request in flight are not read from, which
+        // bounds their buffer and keeps responses in order.
+        fds.assign({{listener, POLLIN, 0}, {m_wake[0], POLLIN, 0}});
+        for (const auto& [fd, conn] : connections) {
+            if (!conn.busy && !conn.eof) {
+                fds.push_back({fd, POLLIN, 0});
+            }
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::string error = strerror(errno);
+            close(listener);
+            throw std::runtime_error("poll: " + error);
+        }
+
+        if (fds[1].revents) {
+            while (read(m_wake[0], chunk, sizeof(chunk)) > 0) {
+            }
+            std::vector<std::pair<int, bool>> done;
+            {
+                std::lock_guard<std::mutex> guard(m_lock);
+                done.swap(m_done);
+            }
+            for (const auto& [fd, ok] : done) {
+                Connection& conn = connections[fd];
+                conn.busy = false;
+                if (!ok || (!dispatch(fd, conn) && conn.eof)) {
+                    drop(fd);
+                }
+            }
+        }
+
+        for (size_t i = 2; i < fds.size(); i++) {
+            if (!fds[i].revents) {
+                continue;
+            }
+            int fd = fds[i].fd;
+            Connection& conn = connections[fd];
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                // Answer what was sent before the client shut down.
+                conn.eof = true;
+                if (!dispatch(fd, conn)) {
+                    drop(fd);
+                }
+                continue;
+            }
+            conn.buffer.append(chunk, size_t(n));
+            if (!dispatch(fd, conn) && conn.buffer.size() > MAX_REQUEST) {
+                static const char error[] = "ERR request too long\n";
+                writeAll(fd, error, sizeof(error) - 1);
+                drop(fd);
+            }
+        }
+
+        if (fds[0].revents) {
+            int fd = accept(listener, nullptr, nullptr);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                std::string error = strerror(errno);
+                close(listener);
+                throw std::runtime_error("accept: " + error);
+            }
+            connections[fd];
+        }
+    }
+}
+
+bool ArchiveServer::dispatch(int fd, Connection& conn) {
+    size_t eol = conn.buffer.find('\n');
+    if (eol == std::string::npos) {
+        return false;
+    }
+    std::string request = conn.buffer.substr(0, eol);
+    conn.buffer.erase(0, eol + 1);
+    conn.busy = true;
+    m_pool.post([this, fd, request]() {
+        LRUCache<std::string>::Value payload;
+        std::string status = handle(request, payload);
+        bool ok = writeAll(fd, status.data(), status.size())
+            && (!payload || writeAll(fd, reinterpret_cast<const char*>(payload->data()), payload->size()));
+        finished(fd, ok);
+    });
+    return true;
+}
+
+void ArchiveServer::finished(int fd, bool ok) {
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+        m_done.emplace_back(fd, ok);
+    }
+    char wake = 0;
+    while (write(m_wake[1], &wake, 1) < 0 && errno == EINTR) {
+    }
+}
+
+static LRUCache<std::string>::Value toPayload(const std::string& text) {
+    return std::make_shared<const std::vector<uint8_t>>(text.begin(), text.end());
+}
+
+std::string ArchiveServer::handle(const std::string& request, LRUCache<std::string>::Value& payload) {
+    m_requests++;
+    try {
+        size_t sp = request.find(' ');
+        std::string verb = request.substr(0, sp);
+        std::string args = sp == std::string::npos ? "" : request.substr(sp + 1);
+        std::ostringstream os;
+
+        if (verb == "GET") {
+            size_t tab = args.find('\t');
+            if (tab == std::string::npos) {
+                return "ERR usage: GET <archive>\\t<entry>\n";
+            }
+            std::string apath = args.substr(0, tab);
+            std::string entry = args.substr(tab + 1);
+            auto open = openArchive(apath);
+            if (!open->archive->exists(entry)) {
+                return "ERR no such entry: " + entry + "\n";
+            }
+            // Keyed by identity of the file on disk, so that entries of a
+            // replaced archive are never served.
+            os << apath << '\t' << open->size << '\t' << open->mtime << '\t' << entry;
+            std::string key = os.str();
+            payload = m_entries.get(key);
+            if (!payload) {
+                payload = std::make_shared<const std::vector<uint8_t>>(open->archive->decompress(entry));
+                m_entries.put(key, payload);
+            }
+        } else if (verb == "LIST") {
+            auto open = openArchive(args);
+            for (const auto& f : open->archive->files()) {
+                os << f.fullPath() << '\t' << f.uncompressed_size << '\t' << f.datetime << '\n';
+            }
+            payload = toPayload(os.str());
+        } else if (verb == "STATS") {
+            os << "requests " << m_requests << "\n"
+                << "archives_open " << m_archives.count() << "\n"
+                << "archives_opened " << m_opened << "\n"
+                << "entries_cached " << m_entries.count() << "\n"
+                << "entries_bytes " << m_entries.cost() << "\n"
+                << "entries_hits " << m_entries.hits() << "\n"
+                << "entries_misses " << m_entries.misses() << "\n";
+            payload = toPayload(os.str());
+        } else {
+            return "ERR unknown request\n";
+        }
+        return "OK " + std::to_string(payload->size()) + "\n";
+    } catch (const std::exception& e) {
+        payload.reset();
+        std::string message = e.what();
+        std::replace(message.begin(), message.end(), '\n', ' ');
+        return "ERR " + message + "\n";
+    }
+}
+
+std::shared_ptr<const ArchiveServer::OpenArchive> ArchiveServer::openArchive(const std::string& apath) {
+    uint64_t size = fs::file_size(apath);
+    int64_t mtime = int64_t(fs::last_write_time(apath).time_since_epoch().count());
+    auto open = m_archives.get(apath);
+    if (open && open->size == size && open->mtime == mtime) {
+        return open;
+    }
+    auto fresh = std::make_shared<OpenArchive>();
+    fresh->archive = std::make_unique<ISArchiveV3>(std::make_shared<const MappedFile>(apath));
+    fresh->size = size;
+    fresh->mtime = mtime;
+    m_opened++;
+    m_archives.put(apath, fresh);
+    return fresh;
+}
@@ -0,0 +1,88 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include "ISArchiveV3.h"
+#include "LRUCache.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Long-running archive server on a Unix domain socket.
+//
+// Recently used archives stay open (memory-mapped, TOC parsed) and decoded
+// entries are kept in a byte-bounded LRU cache, so repeated requests skip
+// opening, parsing and decoding. A single thread polls all connections and
+// hands each complete request to a thread pool, so idle connections hold no
+// worker.
+//
+// Protocol: one request per line, fields separated by tabs; a connection may
+// send any number of requests. They are answered in order, one at a time.
+//
+//   GET <archive>\t<entry>\n    -> OK <size>\n<size bytes of data>
+//   LIST <archive>\n            -> OK <size>\n<one "path\tsize\tdatetime\n" per entry>
+//   STATS\n                     -> OK <size>\n<"key value\n" lines>
+//
+// Errors are answered with "ERR <message>\n". A request line longer than
+// MAX_REQUEST bytes is answered with an error and the connection is closed.
+class ArchiveServer {
+public:
+    ArchiveServer(const std::filesystem::path& socket_path, unsigned threads,
+            uint64_t cache_bytes, size_t max_archives);
+
+    // Accept connections until the process is terminated.
+    void run();
+
+    static constexpr size_t MAX_REQUEST = 64 * 1024;
+
+protected:
+    class Connection {
+    public:
+        std::string buffer;  // received, not yet handled
+        bool busy = false;   // a request is being answered by a worker
+        bool eof = false;    // the client will send no more
+    };
+
+    class OpenArchive {
+    public:
+        std::unique_ptr<ISArchiveV3> archive;
+        uint64_t size;
+        int64_t mtime;
+    };
+
+    // Post the next buffered request of `fd`, if any. False if there is none.
+    bool dispatch(int fd, Connection& conn);
+    // Called by a worker once a response has been written, or failed to.
+    void finished(int fd, bool ok);
+    std::string handle(const std::string& request, LRUCache<std::string>::Value& payload);
+    std::shared_ptr<const OpenArchive> openArchive(const std::string& apath);
+
+    const std::filesystem::path m_socket_path;
+    ThreadPool m_pool;
+    LRUCache<std::string, const OpenArchive> m_archives;
+    LRUCache<std::string> m_entries;
+    std::atomic<uint64_t> m_requests{0};
+    std::atomic<uint64_t> m_opened{0};
+    int m_wake[2] = {-1, -1}; // pipe, written by workers to wake the poll loop
+    std::mutex m_lock;        // guards m_done
+    std::vector<std::pair<int, bool>> m_done;
+};
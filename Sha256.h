@@ -0,0 +1,42 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// SHA-256 (FIPS 180-4), for content keys that must not collide even when an
+// archive is crafted to make them.
+class Sha256 {
+public:
+    Sha256();
+
+    void update(const void* data, size_t len);
+    std::array<uint8_t, 32> digest();
+
+    // Lowercase hex digest of `data`.
+    static std::string hex(const void* data, size_t len);
+
+protected:
+    void block(const uint8_t* p);
+
+    uint32_t m_state[8];
+    uint8_t m_buffer[64];
+    size_t m_buffered = 0;
+    uint64_t m_length = 0; // bytes hashed so far
+};
@@ -0,0 +1,111 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "Stats.h"
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <string>
+
+static const char* PHASE_NAMES[Stats::PHASE_COUNT] = {
+    "toc_parse", "read", "decode", "mkdir", "write"
+};
+
+// syscr + syscw of the calling process, or -1 if /proc/self/io cannot be read
+// (not Linux, or procfs not mounted).
+static int64_t readSyscalls() {
+    std::ifstream io("/proc/self/io");
+    std::string key;
+    uint64_t value;
+    int64_t total = 0;
+    int found = 0;
+    while (io >> key >> value) {
+        if (key == "syscr:" || key == "syscw:") {
+            total += int64_t(value);
+            found++;
+        }
+    }
+    return found == 2 ? total : -1;
+}
+
+Stats::Stats()
+    : m_start(std::chrono::steady_clock::now()),
+      m_syscalls_start(readSyscalls())
+{
+    for (auto& ns : nanoseconds) {
+        ns = 0;
+    }
+}
+
+int64_t Stats::syscalls() const {
+    int64_t now = readSyscalls();
+    if (now < 0 || m_syscalls_start < 0) {
+        return -1;
+    }
+    return now - m_syscalls_start;
+}
+
+static double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Stats::print(std::ostream& os) const {
+    auto flags = os.flags();
+    os << "Statistics:" << "\n";
+    os << "  entries:     " << std::setw(14) << entries << "\n";
+    os << "  bytes_in:    " << std::setw(14) << bytes_in << "\n";
+    os << "  bytes_out:   " << std::setw(14) << bytes_out << "\n";
+    os << "  peak_buffer: " << std::setw(14) << peak_buffer << "\n";
+    os << "  deduplicated:" << std::setw(14) << deduplicated << "\n";
+    os << "  allocations: " << std::setw(14) << allocations << "\n";
+    int64_t calls = syscalls();
+    if (calls >= 0) {
+        os << "  syscalls:    " << std::setw(14) << calls << "\n";
+    } else {
+        os << "  syscalls:    " << std::setw(14) << "unavailable" << "\n";
+    }
+    os << std::fixed << std::setprecision(3);
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        os << "  " << std::left << std::setw(12) << (std::string(PHASE_NAMES[i]) + ":")
+            << std::right << std::setw(11) << nanoseconds[i] / 1e6 << " ms\n";
+    }
+    os << "  total:       " << std::setw(11) << elapsedMs(m_start) << " ms" << std::endl;
+    os.flags(flags);
+}
+
+void Stats::printJson(std::ostream& os) const {
+    auto flags = os.flags();
+    os << "{\"entries\": " << entries
+        << ", \"bytes_in\": " << bytes_in
+        << ", \"bytes_out\": " << bytes_out
+        << ", \"peak_buffer\": " << peak_buffer
+        << ", \"deduplicated\": " << deduplicated
+        << ", \"allocations\": " << allocations
+        << ", \"syscalls\": ";
+    int64_t calls = syscalls();
+    if (calls >= 0) {
+        os << calls;
+    } else {
+        os << "null";
+    }
+    os << std::fixed << std::setprecision(3);
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        os << ", \"" << PHASE_NAMES[i] << "_ms\": " << nanoseconds[i] / 1e6;
+    }
+    os << ", \"total_ms\": " << elapsedMs(m_start) << "}" << std::endl;
+    os.flags(flags);
+}
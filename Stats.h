@@ -0,0 +1,93 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+
+// Counters and timers for the phases of opening and extracting an archive.
+//
+// Instrumented code holds a Stats pointer that is null unless statistics were
+// requested, so a disabled Stats costs one branch per probe and no clock
+// reads.
+class Stats {
+public:
+    enum Phase {
+        TOC_PARSE,
+        READ,
+        DECODE,
+        MKDIR,
+        WRITE,
+        PHASE_COUNT
+    };
+
+    // Adds the lifetime of the timer to `phase`, if `stats` is non-null.
+    class Timer {
+    public:
+        Timer(Stats* stats, Phase phase)
+            : m_stats(stats), m_phase(phase)
+        {
+            if (m_stats) {
+                m_start = std::chrono::steady_clock::now();
+            }
+        }
+        ~Timer() {
+            if (m_stats) {
+                auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - m_start);
+                m_stats->nanoseconds[m_phase] += uint64_t(ns.count());
+            }
+        }
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+    private:
+        Stats* m_stats;
+        Phase m_phase;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    Stats();
+
+    // Record that `bytes` of buffers are live at the same time.
+    void buffer(uint64_t bytes) {
+        uint64_t peak = peak_buffer.load(std::memory_order_relaxed);
+        while (bytes > peak && !peak_buffer.compare_exchange_weak(peak, bytes)) {
+        }
+    }
+
+    // Read and write system calls of the process since construction, from
+    // /proc/self/io; -1 where that is unavailable.
+    int64_t syscalls() const;
+
+    void print(std::ostream& os) const;
+    void printJson(std::ostream& os) const;
+
+    std::atomic<uint64_t> nanoseconds[PHASE_COUNT];
+    std::atomic<uint64_t> entries{0};
+    std::atomic<uint64_t> bytes_in{0};    // compressed bytes read
+    std::atomic<uint64_t> bytes_out{0};   // decompressed bytes produced
+    std::atomic<uint64_t> peak_buffer{0}; // largest in-memory buffer set, bytes
+    std::atomic<uint64_t> deduplicated{0}; // entries linked instead of decoded
+    std::atomic<uint64_t> allocations{0}; // buffers a BufferPool could not reuse
+
+protected:
+    std::chrono::steady_clock::time_point m_start;
+    int64_t m_syscalls_start;
+};
@@ -0,0 +1,79 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#pragma once
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Append-only storage for many small strings, allocated in large blocks.
+// Strings are NUL-terminated and never move, so views into the arena stay
+// valid for its lifetime.
+class StringArena {
+public:
+    explicit StringArena(size_t block_size = 64 * 1024)
+        : m_block_size(block_size)
+    {}
+
+    // Store the concatenation of `parts`.
+    std::string_view add(std::initializer_list<std::string_view> parts) {
+        size_t len = 0;
+        for (auto part : parts) {
+            len += part.size();
+        }
+        char* p = allocate(len + 1);
+        char* begin = p;
+        for (auto part : parts) {
+            memcpy(p, part.data(), part.size());
+            p += part.size();
+        }
+        *p = '\0';
+        return std::string_view(begin, len);
+    }
+
+    std::string_view add(std::string_view s) {
+        return add({s});
+    }
+
+    // Bytes reserved in blocks, for memory accounting.
+    size_t capacity() const {
+        return m_capacity;
+    }
+
+private:
+    char* allocate(size_t len) {
+        if (m_blocks.empty() || m_free < len) {
+            size_t size = len > m_block_size ? len : m_block_size;
+            m_blocks.emplace_back(new char[size]);
+            m_next = m_blocks.back().get();
+            m_free = size;
+            m_capacity += size;
+        }
+        char* p = m_next;
+        m_next += len;
+        m_free -= len;
+        return p;
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    size_t m_block_size;
+    size_t m_capacity = 0;
+    char* m_next = nullptr;
+    size_t m_free = 0;
+};
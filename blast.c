@@ -27,10 +27,19 @@
  * 1.3  24 Aug 2013     - Return unused input from blast()
  *                      - Fix test code to correctly report unused input
  *                      - Enable the provision of initial input to blast()
+ *
+ * Local changes for unshieldv3:
+ *                      - Build the decoding tables thread-safely
+ *                      - Add blast_index() and blast_resume() for random
+ *                        access through decoder checkpoints
  */
 
 #include <stddef.h>             /* for NULL */
 #include <setjmp.h>             /* for setjmp(), longjmp(), and jmp_buf */
+#include <string.h>             /* for memcpy() */
+#ifndef _WIN32
+#include <pthread.h>            /* for pthread_once() */
+#endif
 #include "blast.h"              /* prototype for blast() */
 
 #define local static            /* for local function definitions */
@@ -44,6 +53,7 @@ struct state {
     void *inhow;                /* opaque information passed to infun() */
     unsigned char *in;          /* next input location */
     unsigned left;              /* available input at in */
+    unsigned long inpos;        /* input received, including left */
     int bitbuf;                 /* bit buffer */
     int bitcnt;                 /* number of bits in bit buffer */
 
@@ -55,7 +65,15 @@ struct state {
     void *outhow;               /* opaque information passed to outfun() */
     unsigned next;              /* index of next write location in out[] */
     int first;                  /* true to check distances (for first 4K) */
+    unsigned long outpos;       /* output written by outfun() */
     unsigned char out[MAXWIN];  /* output buffer and sliding window */
+
+    /* checkpoint state */
+    blast_mark markfun;         /* checkpoint function, or NULL */
+    void *markhow;              /* opaque information passed to markfun() */
+    unsigned long interval;     /* output bytes between checkpoints */
+    unsigned long markpos;      /* output position of the next checkpoint */
+    const struct blast_checkpoint *resume;  /* state to start from, or NULL */
 };
 
 /*
@@ -79,6 +97,7 @@ local int bits(struct state *s, int need)
         if (s->left == 0) {
             s->left = s->infun(s->inhow, &(s->in));
             if (s->left == 0) longjmp(s->env, 1);       /* out of input */
+            s->inpos += s->left;
         }
         val |= (int)(*(s->in)++) << s->bitcnt;          /* load eight bits */
         s->left--;
@@ -279,22 +298,16 @@ local int construct(struct huffman *h, const unsigned char *rep, int n)
  *   ignoring whether the length is greater than the distance or not implements
  *   this correctly.
  */
-local int decomp(struct state *s)
+local short litcnt[MAXBITS+1], litsym[256];         /* litcode memory */
+local short lencnt[MAXBITS+1], lensym[16];          /* lencode memory */
+local short distcnt[MAXBITS+1], distsym[64];        /* distcode memory */
+local struct huffman litcode = {litcnt, litsym};    /* length code */
+local struct huffman lencode = {lencnt, lensym};    /* length code */
+local struct huffman distcode = {distcnt, distsym}; /* distance code */
+
+/* set up decoding tables, called exactly once */
+local void build_tables(void)
 {
-    int lit;            /* true if literals are coded */
-    int dict;           /* log2(dictionary size) - 6 */
-    int symbol;         /* decoded symbol, extra bits for distance */
-    int len;            /* length for copy */
-    unsigned dist;      /* distance for copy */
-    int copy;           /* copy counter */
-    unsigned char *from, *to;   /* copy pointers */
-    static int virgin = 1;                              /* build tables once */
-    static short litcnt[MAXBITS+1], litsym[256];        /* litcode memory */
-    static short lencnt[MAXBITS+1], lensym[16];         /* lencode memory */
-    static short distcnt[MAXBITS+1], distsym[64];       /* distcode memory */
-    static struct huffman litcode = {litcnt, litsym};   /* length code */
-    static struct huffman lencode = {lencnt, lensym};   /* length code */
-    static struct huffman distcode = {distcnt, distsym};/* distance code */
         /* bit lengths of literal codes */
     static const unsigned char litlen[] = {
         11, 124, 8, 7, 28, 7, 188, 13, 76, 4, 10, 8, 12, 10, 12, 10, 8, 23, 8,
@@ -307,27 +320,80 @@ local int decomp(struct state *s)
     static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
         /* bit lengths of distance codes 0..63 */
     static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
+
+    construct(&litcode, litlen, sizeof(litlen));
+    construct(&lencode, lenlen, sizeof(lenlen));
+    construct(&distcode, distlen, sizeof(distlen));
+}
+
+#ifndef _WIN32
+local pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+#else
+local int virgin = 1;
+#endif
+
+/*
+ * Pass the state between two symbols to markfun() and schedule the next
+ * checkpoint.
+ */
+local int mark(struct state *s, int lit, int dict)
+{
+    struct blast_checkpoint cp;
+
+    cp.in = s->inpos - s->left;
+    cp.out = s->outpos;
+    cp.bitbuf = s->bitbuf;
+    cp.bitcnt = s->bitcnt;
+    cp.lit = lit;
+    cp.dict = dict;
+    cp.next = s->next;
+    cp.first = s->first;
+    memcpy(cp.window, s->out, MAXWIN);
+    s->markpos = s->outpos + s->next + s->interval;
+    return s->markfun(s->markhow, &cp);
+}
+
+local int decomp(struct state *s)
+{
+    int lit;            /* true if literals are coded */
+    int dict;           /* log2(dictionary size) - 6 */
+    int symbol;         /* decoded symbol, extra bits for distance */
+    int len;            /* length for copy */
+    unsigned dist;      /* distance for copy */
+    int copy;           /* copy counter */
+    unsigned char *from, *to;   /* copy pointers */
     static const short base[16] = {     /* base for length codes */
         3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
     static const char extra[16] = {     /* extra bits for length codes */
         0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
 
-    /* set up decoding tables (once--might not be thread-safe) */
-    if (virgin) {
-        construct(&litcode, litlen, sizeof(litlen));
-        construct(&lencode, lenlen, sizeof(lenlen));
-        construct(&distcode, distlen, sizeof(distlen));
+    /* set up decoding tables (once) */
+#ifndef _WIN32
+    pthread_once(&tables_once, build_tables);
+#else
+    if (virgin) {               /* might not be thread-safe */
+        build_tables();
         virgin = 0;
     }
+#endif
 
-    /* read header */
-    lit = bits(s, 8);
-    if (lit > 1) return -1;
-    dict = bits(s, 8);
-    if (dict < 4 || dict > 6) return -2;
+    /* read header, unless resuming after it */
+    if (s->resume == NULL) {
+        lit = bits(s, 8);
+        if (lit > 1) return -1;
+        dict = bits(s, 8);
+        if (dict < 4 || dict > 6) return -2;
+    }
+    else {
+        lit = s->resume->lit;
+        dict = s->resume->dict;
+    }
 
     /* decode literals and length/distance pairs */
     do {
+        if (s->markfun != NULL && s->outpos + s->next >= s->markpos &&
+            mark(s, lit, dict))
+            return 1;
         if (bits(s, 1)) {
             /* get length */
             symbol = decode(s, &lencode);
@@ -360,6 +426,7 @@ local int decomp(struct state *s)
                 } while (--copy);
                 if (s->next == MAXWIN) {
                     if (s->outfun(s->outhow, s->out, s->next)) return 1;
+                    s->outpos += s->next;
                     s->next = 0;
                     s->first = 0;
                 }
@@ -371,6 +438,7 @@ local int decomp(struct state *s)
             s->out[s->next++] = symbol;
             if (s->next == MAXWIN) {
                 if (s->outfun(s->outhow, s->out, s->next)) return 1;
+                s->outpos += s->next;
                 s->next = 0;
                 s->first = 0;
             }
@@ -379,49 +447,103 @@ local int decomp(struct state *s)
     return 0;
 }
 
-/* See comments in blast.h */
-int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow,
-          unsigned *left, unsigned char **in)
+/*
+ * Run decomp() on an initialized state, return unused input and write any
+ * leftover output.
+ */
+local int run(struct state *s, unsigned *left, unsigned char **in)
 {
-    struct state s;             /* input/output state */
     int err;                    /* return value */
 
-    /* initialize input state */
-    s.infun = infun;
-    s.inhow = inhow;
-    if (left != NULL && *left) {
-        s.left = *left;
-        s.in = *in;
-    }
-    else
-        s.left = 0;
-    s.bitbuf = 0;
-    s.bitcnt = 0;
-
-    /* initialize output state */
-    s.outfun = outfun;
-    s.outhow = outhow;
-    s.next = 0;
-    s.first = 1;
-
     /* return if bits() or decode() tries to read past available input */
-    if (setjmp(s.env) != 0)             /* if came back here via longjmp(), */
+    if (setjmp(s->env) != 0)            /* if came back here via longjmp(), */
         err = 2;                        /*  then skip decomp(), return error */
     else
-        err = decomp(&s);               /* decompress */
+        err = decomp(s);                /* decompress */
 
     /* return unused input */
     if (left != NULL)
-        *left = s.left;
+        *left = s->left;
     if (in != NULL)
-        *in = s.left ? s.in : NULL;
+        *in = s->left ? s->in : NULL;
 
     /* write any leftover output and update the error code if needed */
-    if (err != 1 && s.next && s.outfun(s.outhow, s.out, s.next) && err == 0)
+    if (err != 1 && s->next && s->outfun(s->outhow, s->out, s->next) && err == 0)
         err = 1;
     return err;
 }
 
+/* Set up a state to decompress from the start of the stream */
+local void init(struct state *s, blast_in infun, void *inhow,
+                blast_out outfun, void *outhow)
+{
+    /* initialize input state */
+    s->infun = infun;
+    s->inhow = inhow;
+    s->left = 0;
+    s->inpos = 0;
+    s->bitbuf = 0;
+    s->bitcnt = 0;
+
+    /* initialize output state */
+    s->outfun = outfun;
+    s->outhow = outhow;
+    s->next = 0;
+    s->first = 1;
+    s->outpos = 0;
+
+    /* no checkpoints */
+    s->markfun = NULL;
+    s->resume = NULL;
+}
+
+/* See comments in blast.h */
+int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow,
+          unsigned *left, unsigned char **in)
+{
+    struct state s;             /* input/output state */
+
+    init(&s, infun, inhow, outfun, outhow);
+    if (left != NULL && *left) {
+        s.left = *left;
+        s.in = *in;
+        s.inpos = *left;
+    }
+    return run(&s, left, in);
+}
+
+/* See comments in blast.h */
+int blast_index(blast_in infun, void *inhow, blast_out outfun, void *outhow,
+                blast_mark markfun, void *markhow, unsigned long interval)
+{
+    struct state s;             /* input/output state */
+
+    init(&s, infun, inhow, outfun, outhow);
+    s.markfun = markfun;
+    s.markhow = markhow;
+    s.interval = interval ? interval : 1;
+    s.markpos = s.interval;
+    return run(&s, NULL, NULL);
+}
+
+/* See comments in blast.h */
+int blast_resume(const struct blast_checkpoint *cp,
+                 blast_in infun, void *inhow, blast_out outfun, void *outhow)
+{
+    struct state s;             /* input/output state */
+
+    init(&s, infun, inhow, outfun, outhow);
+    s.inpos = cp->in;
+    s.bitbuf = cp->bitbuf;
+    s.bitcnt = cp->bitcnt;
+    s.next = cp->next;
+    s.first = cp->first;
+    s.outpos = cp->out;
+    memcpy(s.out, cp->window, MAXWIN);
+    s.resume = cp;
+    return run(&s, NULL, NULL);
+}
+
 #ifdef TEST
 /* Example of how to use blast() */
 #include <stdio.h>
@@ -19,8 +19,13 @@
   3. This notice may not be removed or altered from any source distribution.
 
   Mark Adler    madler@alumni.caltech.edu
+
+  Altered for unshieldv3: blast_index() and blast_resume() were added.
  */
 
+#ifndef BLAST_H
+#define BLAST_H
+
 
 /*
  * blast() decompresses the PKWare Data Compression Library (DCL) compressed
@@ -81,3 +86,39 @@ int blast(blast_in infun, void *inhow, blast_out outfun, void *outhow,
  * At the bottom of blast.c is an example program that uses blast() that can be
  * compiled to produce a command-line decompression filter by defining TEST.
  */
+
+
+struct blast_checkpoint {
+    unsigned long in;           /* compressed bytes consumed */
+    unsigned long out;          /* output bytes written before window[0] */
+    int bitbuf;                 /* unused bits of the last input byte */
+    int bitcnt;                 /* number of bits in bitbuf, 0..7 */
+    int lit;                    /* literal flag from the stream header */
+    int dict;                   /* dictionary size from the stream header */
+    unsigned next;              /* bytes of window[] not yet written */
+    int first;                  /* true while still in the first 4K */
+    unsigned char window[4096]; /* sliding window */
+};
+typedef int (*blast_mark)(void *how, const struct blast_checkpoint *cp);
+/* Decoder state between two symbols, from which blast_resume() continues.
+ */
+
+
+int blast_index(blast_in infun, void *inhow, blast_out outfun, void *outhow,
+                blast_mark markfun, void *markhow, unsigned long interval);
+/* Like blast(), but also calls err = markfun(how, cp) with a checkpoint each
+ * time at least interval more bytes have been decompressed.  If err is not
+ * zero, blast_index() returns with an output error.  The checkpoint is only
+ * valid during the call.
+ */
+
+
+int blast_resume(const struct blast_checkpoint *cp,
+                 blast_in infun, void *inhow, blast_out outfun, void *outhow);
+/* Continue decompressing from a checkpoint taken by blast_index().  infun()
+ * must provide the compressed stream starting cp->in bytes into it.  Output
+ * starts at position cp->out of the decompressed data, so the first cp->next
+ * bytes written are the ones already in the window.  Returns as blast().
+ */
+
+#endif /* BLAST_H */
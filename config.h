@@ -0,0 +1,6 @@
+#pragma once
+
+#define CMAKE_PROJECT_NAME "unshieldv3"
+#define CMAKE_PROJECT_VER  "0.2.2"
+
+/* #undef HAVE_FUSE */
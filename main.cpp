@@ -16,13 +16,36 @@ limitations under the License.
 
 #include "config.h"
 #include "ISArchiveV3.h"
+#include "Catalog.h"
+#include "Scanner.h"
+#include "SeekIndex.h"
+#include "MappedFile.h"
+#include "PackArchive.h"
+#include "BlobStore.h"
+#include "BufferPool.h"
+#include "MemoryBudget.h"
+#include "Progress.h"
+#ifdef HAVE_FUSE
+#include "Mount.h"
+#endif
+#ifndef _WIN32
+#include "Server.h"
+#endif
 #include <iostream>
 #include <iomanip>
 #include <vector>
 #include <deque>
+#include <map>
 #include <string>
 #include <algorithm>
 #include <chrono>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <sstream>
+#include <fstream>
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -46,11 +69,32 @@ void info(const ISArchiveV3& archive) {
     }
 }
 
-void list_archive(const ISArchiveV3& archive, bool verbose = false) {
+// Files of `dir` and its subdirectories, or all files for nullptr.
+vector<const ISArchiveV3::File*> select_files(const ISArchiveV3& archive, const ISArchiveV3::Directory* dir) {
+    if (dir) {
+        return archive.subtree(*dir);
+    }
+    vector<const ISArchiveV3::File*> files;
+    files.reserve(archive.files().size());
+    for (auto& f : archive.files()) {
+        files.push_back(&f);
+    }
+    return files;
+}
+
+// One line of `list`, from an archive or a pack.
+class ListEntry {
+public:
+    string_view path;
+    uint64_t size;
+    std::tm tm;
+};
+
+void print_listing(const vector<ListEntry>& entries, bool verbose) {
     size_t max_path = 0;
     if (verbose) {
-        for (auto& f : archive.files()) {
-            max_path = max(f.full_path.size(), max_path);
+        for (const auto& e : entries) {
+            max_path = max(e.path.size(), max_path);
         }
         cout << left << setw(max_path) << "Path" << "  "
             << right << setw(8) << "Size" << "  "
@@ -62,75 +106,600 @@ void list_archive(const ISArchiveV3& archive, bool verbose = false) {
             << endl;
     }
 
-    for (auto& f : archive.files()) {
+    for (const auto& e : entries) {
         if (verbose) {
-            std::tm tm = f.tm();
-            cout << left << setw(max_path) << f.full_path << "  "
-                << right << setw(8) << f.uncompressed_size << "  "
-                << std::put_time(&tm, "%Y-%m-%d %H:%M:%S") << "  "
+            cout << left << setw(max_path) << e.path << "  "
+                << right << setw(8) << e.size << "  "
+                << std::put_time(&e.tm, "%Y-%m-%d %H:%M:%S") << "  "
                 << endl;
         } else {
-            cout << f.full_path << endl;
+            cout << e.path << endl;
         }
     }
 }
 
-bool extract(ISArchiveV3& archive, const fs::path& destination) {
-    if (destination.empty()) {
-        cerr << "Please specify a destination directory." << endl;
+void list_archive(const ISArchiveV3& archive, bool verbose = false, const ISArchiveV3::Directory* dir = nullptr) {
+    vector<ListEntry> entries;
+    for (auto* f : select_files(archive, dir)) {
+        entries.push_back({f->fullPath(), f->uncompressed_size, f->tm()});
+    }
+    print_listing(entries, verbose);
+}
+
+class ExtractOptions {
+public:
+    const ISArchiveV3::Directory* directory = nullptr; // only this subtree
+    bool dedup = false;             // decode identical entries only once
+    LinkMode link_mode = LinkMode::HARDLINK;
+    const BlobStore* store = nullptr;
+    const vector<const ISArchiveV3::File*>* only = nullptr; // instead of directory
+    unsigned jobs = 1;              // entries extracted in parallel
+    uint64_t max_memory = 0;        // bytes for in-flight buffers, 0: no limit
+    ISArchiveV3::Limits limits;
+    Progress::Mode progress = Progress::Mode::FILES;
+
+    bool scheduled() const {
+        return jobs > 1 || max_memory > 0;
+    }
+};
+
+// State shared by the workers of one extraction.
+class ExtractState {
+public:
+    ExtractState(Progress::Mode mode)
+        : progress(mode, cout, cerr)
+    {}
+
+    Progress progress;
+    mutex lock; // guards seen and error messages
+    // First extracted entry for each distinct stored content.
+    map<string, pair<const ISArchiveV3::File*, fs::path>> seen;
+};
+
+// Unlink `dest` before it is rewritten, so that writing never goes through a
+// hard link made by --dedup=hardlink into another file.
+void unlink_file(const fs::path& dest) {
+    error_code ec;
+    fs::remove(dest, ec);
+}
+
+bool write_file(const fs::path& dest, const uint8_t* data, size_t size, Stats* stats) {
+    Stats::Timer timer(stats, Stats::WRITE);
+    unlink_file(dest);
+    ofstream fout(dest, ios::binary | ios::out);
+    if (fout.fail()) {
+        cerr << dest << endl;
+        cerr << "Could not create file: " << dest << endl;
         return false;
     }
-    if (!fs::exists(destination)) {
-        cerr << "Destination directory not found: " << destination << endl;
+    fout.write(reinterpret_cast<const char*>(data), streamsize(size));
+    if (fout.fail()) {
+        cerr << "Could not write to: " << dest << endl;
+        return false;
+    }
+    fout.close();
+    return true;
+}
+
+bool write_file(const fs::path& dest, const vector<uint8_t>& contents, Stats* stats) {
+    return write_file(dest, contents.data(), contents.size(), stats);
+}
+
+// Decode an entry piece by piece straight into `dest`.
+bool stream_file(ISArchiveV3& archive, const ISArchiveV3::File& file, const fs::path& dest) {
+    Stats* stats = archive.stats();
+    unlink_file(dest);
+    ofstream fout(dest, ios::binary | ios::out);
+    if (fout.fail()) {
+        cerr << "Could not create file: " << dest << endl;
+        return false;
+    }
+    try {
+        archive.decompress(file, [&](const uint8_t* data, size_t len) {
+            Stats::Timer timer(stats, Stats::WRITE);
+            fout.write(reinterpret_cast<const char*>(data), streamsize(len));
+            return !fout.fail();
+        });
+    } catch (...) {
+        // don't leave a truncated file behind
+        fout.close();
+        fs::remove(dest);
+        throw;
+    }
+    fout.close();
+    if (fout.fail()) {
+        cerr << "Could not write to: " << dest << endl;
         return false;
     }
-    for (auto& file : archive.files()) {
-        cout << file.full_path << endl;
-        cout << "      Compressed size: " << setw(10) << file.compressed_size << endl;
-        auto contents = archive.decompress(file.full_path);
-        cout << "    Uncompressed size: " << setw(10) << contents.size() << endl;
+    return true;
+}
 
-        fs::path dest = destination / file.path();
-        fs::path dest_dir = dest.parent_path();
+// Extract one entry. Large entries are decoded in memory unless `stream`.
+bool extract_file(ISArchiveV3& archive, const ISArchiveV3::File& file, const fs::path& destination,
+        const ExtractOptions& options, BufferPool& pool, ExtractState& state, bool stream = false)
+{
+    Stats* stats = archive.stats();
+    Progress& progress = state.progress;
+    // before any buffer is sized from the TOC
+    archive.checkLimits(file);
+    fs::path dest = destination / file.path();
+    fs::path dest_dir = dest.parent_path();
+    {
+        Stats::Timer timer(stats, Stats::MKDIR);
         if (!fs::create_directories(dest_dir)) {
             if (!fs::exists(dest_dir)) {
                 cerr << "Could not create directory: " << dest_dir << endl;
                 return false;
             }
         }
-        ofstream fout(dest, ios::binary | ios::out);
-        if (fout.fail()) {
-            cerr << dest << endl;
-            cerr << "Could not create file: " << dest << endl;
+    }
+
+    if (!options.dedup && !options.store) {
+        if (stream) {
+            if (!stream_file(archive, file, dest)) {
+                return false;
+            }
+            progress.entry(file, file.uncompressed_size);
+            return true;
+        }
+        auto contents = pool.get(file.decodedSizeHint());
+        auto input = pool.get(archive.mapped() ? 0 : file.compressed_size);
+        archive.decompress(file, *contents, *input);
+        if (!write_file(dest, *contents, stats)) {
+            return false;
+        }
+        progress.entry(file, contents->size());
+        return true;
+    }
+
+    auto compressed = pool.get(file.compressed_size);
+    archive.readCompressed(file, *compressed);
+    string key = BlobStore::key(*compressed, file.uncompressed_size,
+            file.attrib & ISArchiveV3::File::Attributes::UNCOMPRESSED);
+    pair<const ISArchiveV3::File*, fs::path> first;
+    {
+        lock_guard<mutex> lock(state.lock);
+        auto it = state.seen.find(key);
+        if (it != state.seen.end()) {
+            first = it->second;
+        }
+    }
+    auto same_stored = [&](const ISArchiveV3::File& other) {
+        auto buf = pool.get(other.compressed_size);
+        archive.readCompressed(other, *buf);
+        return *buf == *compressed;
+    };
+    if (options.dedup && first.first && same_stored(*first.first)) {
+        linkFile(first.second, dest, options.link_mode);
+        progress.entry(file, file.uncompressed_size, Progress::Source::DUPLICATE,
+                first.first->fullPath());
+        if (stats) {
+            stats->deduplicated++;
+        }
+        return true;
+    }
+    if (options.store && options.store->fetch(key, dest)) {
+        progress.entry(file, file.uncompressed_size, Progress::Source::STORE, key);
+        if (stats) {
+            stats->deduplicated++;
+        }
+        lock_guard<mutex> lock(state.lock);
+        state.seen.emplace(key, make_pair(&file, dest));
+        return true;
+    }
+
+    if (stream) {
+        if (!stream_file(archive, file, dest)) {
             return false;
         }
-        fout.write(reinterpret_cast<char*>(contents.data()), long(contents.size()));
-        if (fout.fail()) {
-            cerr << "Could not write to: " << dest << endl;
+        progress.entry(file, file.uncompressed_size);
+    } else {
+        auto contents = pool.get(file.decodedSizeHint());
+        archive.decode(file, *compressed, *contents);
+        if (!write_file(dest, *contents, stats)) {
             return false;
         }
-        fout.close();
+        progress.entry(file, contents->size());
+    }
+    if (options.store) {
+        options.store->put(key, dest);
+    }
+    // Only now may later duplicates link to the file.
+    lock_guard<mutex> lock(state.lock);
+    state.seen.emplace(key, make_pair(&file, dest));
+    return true;
+}
+
+// Buffer bytes extract_file() needs for an entry.
+uint64_t extract_cost(const ISArchiveV3& archive, const ISArchiveV3::File& file,
+        const ExtractOptions& options, bool stream)
+{
+    const uint64_t STREAM_COST = 64 * 1024; // decoder window and file buffer
+    uint64_t cost = stream ? STREAM_COST : BufferPool::capacityFor(file.decodedSizeHint());
+    if (options.dedup || options.store) {
+        cost += 2 * BufferPool::capacityFor(file.compressed_size);
+    } else if (!archive.mapped()) {
+        cost += BufferPool::capacityFor(file.compressed_size);
+    }
+    return cost;
+}
+
+// Extract entries on `options.jobs` workers, admitting an entry only while
+// the buffers of all entries in flight fit in `options.max_memory`. Entries
+// too large to share the budget are streamed to disk.
+bool extract_scheduled(ISArchiveV3& archive, const vector<const ISArchiveV3::File*>& files,
+        const fs::path& destination, const ExtractOptions& options, ExtractState& state)
+{
+    unsigned jobs = max(options.jobs, 1u);
+    uint64_t budget = options.max_memory ? options.max_memory : UINT64_MAX;
+    // Buffers kept for reuse take at most a quarter of the budget.
+    uint64_t pool_bytes = options.max_memory ? options.max_memory / 4 / jobs : 64 << 20;
+    MemoryBudget admission(options.max_memory ? budget - pool_bytes * jobs : budget);
+    uint64_t stream_above = options.max_memory ? admission.limit() / (2 * jobs) : UINT64_MAX;
+    Stats* stats = archive.stats();
+
+    atomic<size_t> next{0};
+    atomic<bool> ok{true};
+    auto work = [&]() {
+        BufferPool pool(pool_bytes);
+        for (size_t i; ok && (i = next++) < files.size(); ) {
+            const ISArchiveV3::File& file = *files[i];
+            bool stream = extract_cost(archive, file, options, false) > stream_above;
+            uint64_t cost = extract_cost(archive, file, options, stream);
+            uint64_t in_flight = admission.acquire(cost);
+            if (stats) {
+                stats->buffer(in_flight);
+            }
+            try {
+                if (!extract_file(archive, file, destination, options, pool, state, stream)) {
+                    ok = false;
+                }
+            } catch (const std::exception& e) {
+                lock_guard<mutex> lock(state.lock);
+                cerr << "Could not extract " << file.fullPath() << ": " << e.what() << endl;
+                ok = false;
+            }
+            admission.release(cost);
+        }
+        if (stats) {
+            stats->allocations += pool.allocations();
+        }
+    };
+    vector<thread> workers;
+    for (unsigned j = 1; j < jobs; j++) {
+        workers.emplace_back(work);
+    }
+    work();
+    for (auto& t : workers) {
+        t.join();
+    }
+    return ok;
+}
+
+bool extract(ISArchiveV3& archive, const fs::path& destination, const ExtractOptions& options = {}) {
+    if (destination.empty()) {
+        cerr << "Please specify a destination directory." << endl;
+        return false;
+    }
+    if (!fs::exists(destination)) {
+        cerr << "Destination directory not found: " << destination << endl;
+        return false;
+    }
+    archive.setLimits(options.limits);
+    ExtractState state(options.progress);
+    auto files = options.only ? *options.only : select_files(archive, options.directory);
+    uint64_t total_bytes = 0;
+    for (auto* f : files) {
+        total_bytes += f->uncompressed_size;
+    }
+    state.progress.start(files.size(), total_bytes);
+    if (options.scheduled()) {
+        bool ok = extract_scheduled(archive, files, destination, options, state);
+        state.progress.finish();
+        return ok;
+    }
+    BufferPool pool;
+    bool ok = true;
+    for (auto* f : files) {
+        if (!extract_file(archive, *f, destination, options, pool, state)) {
+            ok = false;
+            break;
+        }
+    }
+    state.progress.finish();
+    if (archive.stats()) {
+        archive.stats()->allocations += pool.allocations();
+    }
+    return ok;
+}
+
+// Scheduled extraction decodes from several threads, which needs a mapping.
+unique_ptr<ISArchiveV3> open_for_extract(const fs::path& apath, uint64_t offset,
+        Stats* stats, const ExtractOptions& options)
+{
+    if (options.scheduled()) {
+        return make_unique<ISArchiveV3>(make_shared<const MappedFile>(apath), offset, stats);
+    }
+    return make_unique<ISArchiveV3>(apath, offset, stats);
+}
+
+// Entries of `pack` below directory `dir`, or all of them for "", in pack
+// order. Reports a directory that holds no entries.
+bool select_packed(const PackArchive& pack, string dir, vector<const PackArchive::Entry*>& entries) {
+    replace(dir.begin(), dir.end(), '/', '\\');
+    while (!dir.empty() && dir.back() == '\\') {
+        dir.pop_back();
+    }
+    string prefix = dir.empty() ? "" : dir + "\\";
+    for (uint32_t i = 0; i < pack.entryCount(); i++) {
+        const PackArchive::Entry& e = pack.entry(i);
+        if (pack.fullPath(e).substr(0, prefix.size()) == prefix) {
+            entries.push_back(&e);
+        }
+    }
+    if (entries.empty() && !dir.empty()) {
+        cerr << "Directory not found in archive: " << dir << endl;
+        return false;
+    }
+    return true;
+}
+
+void info_packed(const PackArchive& pack, const fs::path& ppath) {
+    uint64_t compressed = 0;
+    uint64_t uncompressed = 0;
+    for (uint32_t i = 0; i < pack.entryCount(); i++) {
+        compressed += pack.entry(i).compressed_size;
+        uncompressed += pack.entry(i).size;
+    }
+    cout << "Pack: " << ppath.string() << endl;
+    cout << "File count: " << pack.entryCount() << endl;
+    cout << "Compressed size: " << compressed << endl;
+    cout << "Uncompressed size: " << uncompressed << endl;
+}
+
+void list_packed(const PackArchive& pack, const vector<const PackArchive::Entry*>& entries, bool verbose) {
+    vector<ListEntry> listing;
+    for (auto* e : entries) {
+        listing.push_back({pack.fullPath(*e), e->size, pack.tm(*e)});
+    }
+    print_listing(listing, verbose);
+}
+
+// `extract` from a pack: entries are written straight from the mapping, so
+// options about decoding do not apply.
+bool extract_packed(const PackArchive& pack, const vector<const PackArchive::Entry*>& entries,
+        const fs::path& destination, const ExtractOptions& options, Stats* stats)
+{
+    if (!fs::exists(destination)) {
+        cerr << "Destination directory not found: " << destination << endl;
+        return false;
+    }
+    Progress progress(options.progress, cout, cerr);
+    uint64_t total_bytes = 0;
+    for (auto* e : entries) {
+        total_bytes += e->size;
+    }
+    progress.start(entries.size(), total_bytes);
+    bool ok = true;
+    for (auto* e : entries) {
+        fs::path dest = destination / pack.path(*e);
+        {
+            Stats::Timer timer(stats, Stats::MKDIR);
+            fs::create_directories(dest.parent_path());
+        }
+        if (!write_file(dest, pack.data(*e), e->size, stats)) {
+            ok = false;
+            break;
+        }
+        progress.entry(pack.fullPath(*e), e->compressed_size, e->size);
+        if (stats) {
+            stats->entries++;
+            stats->bytes_out += e->size;
+        }
+    }
+    progress.finish();
+    return ok;
+}
+
+// Whether entries `a` and `b` of two archives hold the same contents,
+// decoding them only if their stored bytes differ. Counts decoded pairs.
+bool same_contents(ISArchiveV3& old_archive, const ISArchiveV3::File& a,
+        ISArchiveV3& new_archive, const ISArchiveV3::File& b, BufferPool& pool, uint64_t& decoded)
+{
+    if (a.compressed_size == b.compressed_size) {
+        auto raw_a = pool.get(a.compressed_size);
+        auto raw_b = pool.get(b.compressed_size);
+        old_archive.readCompressed(a, *raw_a);
+        new_archive.readCompressed(b, *raw_b);
+        if (*raw_a == *raw_b) {
+            return true;
+        }
+    }
+    const uint8_t stored = ISArchiveV3::File::Attributes::UNCOMPRESSED;
+    if (a.attrib & b.attrib & stored) {
+        return false;
+    }
+    // The same contents may have been stored differently.
+    decoded++;
+    auto data_a = pool.get(a.decodedSizeHint());
+    auto data_b = pool.get(b.decodedSizeHint());
+    auto input = pool.get(0);
+    old_archive.decompress(a, *data_a, *input);
+    new_archive.decompress(b, *data_b, *input);
+    return *data_a == *data_b;
+}
+
+// Print one line per entry added (A), removed (D) or changed (M) between two
+// archives, joined by full path. An entry whose size, date or attributes
+// differ has changed; otherwise its contents are compared, whether or not
+// they are stored compressed.
+void diff_archives(ISArchiveV3& old_archive, ISArchiveV3& new_archive) {
+    BufferPool pool;
+    uint64_t added = 0, removed = 0, changed = 0, decoded = 0;
+    for (const auto& b : new_archive.files()) {
+        const ISArchiveV3::File* a = old_archive.file(b.fullPath());
+        if (a == nullptr) {
+            cout << "A\t" << b.fullPath() << "\n";
+            added++;
+        } else if (a->uncompressed_size != b.uncompressed_size || a->datetime != b.datetime
+                || (a->attrib ^ b.attrib) & ~ISArchiveV3::File::Attributes::UNCOMPRESSED
+                || !same_contents(old_archive, *a, new_archive, b, pool, decoded)) {
+            cout << "M\t" << b.fullPath() << "\n";
+            changed++;
+        }
+    }
+    for (const auto& a : old_archive.files()) {
+        if (!new_archive.exists(a.fullPath())) {
+            cout << "D\t" << a.fullPath() << "\n";
+            removed++;
+        }
+    }
+    cout << flush;
+    cerr << added << " added, " << removed << " removed, " << changed << " changed ("
+         << decoded << " decoded)" << endl;
+}
+
+// Entries named in a list file, one path per line, looked up in an archive
+// or a pack by `lookup`. Lines of `diff` output are accepted as well: removed
+// (D) entries are skipped.
+template<class Entry, class Lookup>
+bool read_entry_list(const fs::path& lpath, Lookup lookup, vector<const Entry*>& files) {
+    ifstream fin_file;
+    istream* in = &cin;
+    if (lpath != "-") {
+        fin_file.open(lpath);
+        if (!fin_file.is_open()) {
+            cerr << "Cannot open entry list: " << lpath << endl;
+            return false;
+        }
+        in = &fin_file;
+    }
+    string line;
+    while (getline(*in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.size() >= 2 && line[1] == '\t') {
+            if (line[0] == 'D') {
+                continue;
+            }
+            line.erase(0, 2);
+        }
+        if (line.empty()) {
+            continue;
+        }
+        replace(line.begin(), line.end(), '/', '\\');
+        const Entry* file = lookup(line);
+        if (file == nullptr) {
+            cerr << "File not found in archive: " << line << endl;
+            return false;
+        }
+        files.push_back(file);
     }
     return true;
 }
 
+void find_in_catalog(const Catalog& catalog, const string& name) {
+    for (const auto* e : catalog.find(name)) {
+        std::tm tm = ISArchiveV3::dosDateTime(e->datetime);
+        cout << catalog.archivePath(catalog.archive(e->archive)) << "\t"
+            << catalog.entryPath(*e) << "\t"
+            << e->uncompressed_size << "\t"
+            << std::put_time(&tm, "%Y-%m-%d %H:%M:%S")
+            << "\n";
+    }
+}
+
 /**********************************************************************
  *  Command-line
  **********************************************************************/
 int cmd_help(deque<string> subargs = {}) {
     cerr << "unshieldv3 version " << CMAKE_PROJECT_VER << endl;
     cerr << "usage: " << endl;
-    cerr << "  unshieldv3 help                        Produce this message" << endl;
-    cerr << "  unshieldv3 info ARCHIVE.Z              Show archive metadata" << endl;
-    cerr << "  unshieldv3 list [-v] ARCHIVE.Z         List ARCHIVE contents" << endl;
-    cerr << "  unshieldv3 extract ARCHIVE.Z DESTDIR   Extract ARCHIVE to DESTDIR" << endl;
+    cerr << "  unshieldv3 help                              Produce this message" << endl;
+    cerr << "  unshieldv3 info [-o OFFSET] ARCHIVE.Z        Show archive metadata" << endl;
+    cerr << "  unshieldv3 list [-o OFFSET] [-v] ARCHIVE.Z [DIR]" << endl;
+    cerr << "                                               List ARCHIVE contents, or only DIR" << endl;
+    cerr << "  unshieldv3 extract [-o OFFSET] [OPTIONS] ARCHIVE.Z DESTDIR [DIR]" << endl;
+    cerr << "                                               Extract ARCHIVE, or only DIR, to DESTDIR" << endl;
+    cerr << "  unshieldv3 extract-many [OPTIONS] DESTDIR ARCHIVE.Z..." << endl;
+    cerr << "                                               Extract each ARCHIVE to DESTDIR/ARCHIVE" << endl;
+    cerr << "  unshieldv3 read [-o OFFSET] [OPTIONS] ARCHIVE.Z ENTRY START LENGTH" << endl;
+    cerr << "                                               Write LENGTH bytes of ENTRY from START to stdout" << endl;
+    cerr << "  unshieldv3 diff OLD.Z NEW.Z                  List entries added (A), removed (D)" << endl;
+    cerr << "                                               or changed (M) in NEW" << endl;
+    cerr << "  unshieldv3 pack [-o OFFSET] ARCHIVE.Z PACKFILE" << endl;
+    cerr << "                                               Decode ARCHIVE once into an uncompressed" << endl;
+    cerr << "                                               pack that is read in place" << endl;
+    cerr << "  unshieldv3 mount [-o OFFSET] [-f] [--cache MB] ARCHIVE.Z MOUNTPOINT" << endl;
+    cerr << "                                               Mount ARCHIVE read-only (FUSE)" << endl;
+    cerr << "  unshieldv3 serve [-j N] [--cache MB] [--archives N] SOCKET" << endl;
+    cerr << "                                               Serve archive entries on a Unix socket" << endl;
+    cerr << "  unshieldv3 scan FILE...                      Find archives embedded in FILEs" << endl;
+    cerr << "  unshieldv3 index [-j N] CATALOG PATH...      Index archives in PATHs into CATALOG" << endl;
+    cerr << "  unshieldv3 find CATALOG NAME...              Find archives containing NAME" << endl;
+    cerr << endl;
+    cerr << "  -o OFFSET          open an archive embedded at OFFSET, as reported by scan" << endl;
+    cerr << endl;
+    cerr << "info, list, extract and read also accept a PACKFILE for ARCHIVE.Z; its" << endl;
+    cerr << "entries are read in place, so extract options about decoding do not apply." << endl;
+    cerr << endl;
+    cerr << "extract options:" << endl;
+    cerr << "  --stats[=json]     print per-phase timings and counters to stderr" << endl;
+    cerr << "  --dedup[=MODE]     decode identical entries once; materialize copies" << endl;
+    cerr << "                     by MODE: hardlink (default), reflink or copy" << endl;
+    cerr << "  --store DIR        share decoded files across runs in a content-addressed" << endl;
+    cerr << "                     store in DIR, whose blobs are never hard-linked" << endl;
+    cerr << "  -q, --progress[=MODE]" << endl;
+    cerr << "                     report entries by MODE: quiet (-q), summary (status" << endl;
+    cerr << "                     line with throughput and ETA), files (default) or json" << endl;
+    cerr << "  --only LIST        extract only the entries listed in file LIST (- for" << endl;
+    cerr << "                     stdin), one per line; diff output is accepted" << endl;
+    cerr << "  -j N               extract N entries at a time" << endl;
+    cerr << "  --max-memory MB    cap the buffers of entries in flight; entries too" << endl;
+    cerr << "                     large to share the cap are streamed to disk" << endl;
+    cerr << "  --max-entry-size MB" << endl;
+    cerr << "                     refuse entries that decode to more than MB" << endl;
+    cerr << "  --max-total MB     stop after decoding MB from one archive" << endl;
+    cerr << "  --max-ratio N      refuse entries claiming to expand more than N-fold" << endl;
+    cerr << "  --time-limit SEC   stop decoding an entry after SEC seconds" << endl;
+    cerr << endl;
+    cerr << "read options:" << endl;
+    cerr << "  --index FILE       keep decoder checkpoints of ENTRY in FILE, so that later" << endl;
+    cerr << "                     reads resume near START instead of decoding from the" << endl;
+    cerr << "                     beginning; built on first use" << endl;
+    cerr << "  --interval KB      output between checkpoints (default: 256)" << endl;
     return 1;
 }
 
+// Consume a leading "-o OFFSET" option (decimal or 0x-prefixed hex). False
+// if "-o" is not followed by a valid offset.
+bool parse_offset(deque<string>& subargs, uint64_t& offset) {
+    if (subargs.empty() || subargs[0] != "-o") {
+        return true;
+    }
+    if (subargs.size() < 2) {
+        return false;
+    }
+    try {
+        size_t pos;
+        offset = stoull(subargs[1], &pos, 0);
+        if (pos != subargs[1].size()) {
+            return false;
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    subargs.pop_front();
+    subargs.pop_front();
+    return true;
+}
+
 int cmd_info(deque<string> subargs) {
     string apath;
+    uint64_t offset = 0;
 
-    if (subargs.size() != 1) {
+    if (!parse_offset(subargs, offset) || subargs.size() != 1) {
         return cmd_help();
     }
 
@@ -140,23 +709,44 @@ int cmd_info(deque<string> subargs) {
         return 1;
     }
 
-    ISArchiveV3 archive(apath);
+    if (offset == 0 && PackArchive::isPack(apath)) {
+        info_packed(PackArchive(apath), apath);
+        return 0;
+    }
+    ISArchiveV3 archive(apath, offset);
     info(archive);
     return 0;
 }
 
+// Look up a directory given with either separator; reports unknown paths.
+const ISArchiveV3::Directory* find_directory(const ISArchiveV3& archive, string path) {
+    replace(path.begin(), path.end(), '/', '\\');
+    while (!path.empty() && path.back() == '\\') {
+        path.pop_back();
+    }
+    const ISArchiveV3::Directory* dir = archive.directoryByPath(path);
+    if (!dir) {
+        cerr << "Directory not found in archive: " << path << endl;
+    }
+    return dir;
+}
+
 int cmd_list(deque<string> subargs) {
     bool verbose = false;
     string apath;
+    uint64_t offset = 0;
 
-    if (subargs.size() == 0) {
+    if (!parse_offset(subargs, offset) || subargs.size() == 0) {
         return cmd_help();
     }
     if (subargs[0] == "-v") {
         verbose = true;
         subargs.pop_front();
     }
-    if (subargs.size() == 1) {
+    if (!parse_offset(subargs, offset)) {
+        return cmd_help();
+    }
+    if (subargs.size() == 1 || subargs.size() == 2) {
         apath = subargs[0];
     } else {
         return cmd_help();
@@ -165,18 +755,107 @@ int cmd_list(deque<string> subargs) {
         cerr << "Archive not found: " << apath << endl;
         return 1;
     }
-    ISArchiveV3 archive(apath);
-    list_archive(archive, verbose);
+    if (offset == 0 && PackArchive::isPack(apath)) {
+        PackArchive pack(apath);
+        vector<const PackArchive::Entry*> entries;
+        if (!select_packed(pack, subargs.size() == 2 ? subargs[1] : "", entries)) {
+            return 1;
+        }
+        list_packed(pack, entries, verbose);
+        return 0;
+    }
+    ISArchiveV3 archive(apath, offset);
+    const ISArchiveV3::Directory* dir = nullptr;
+    if (subargs.size() == 2 && !(dir = find_directory(archive, subargs[1]))) {
+        return 1;
+    }
+    list_archive(archive, verbose, dir);
     return 0;
 }
 
+// Consume one option shared by extract and extract-many.
+bool parse_extract_option(deque<string>& subargs, ExtractOptions& options,
+        fs::path& store_dir, string& stats_format)
+{
+    const string& arg = subargs[0];
+    if (arg == "--stats" || arg == "--stats=text") {
+        stats_format = "text";
+    } else if (arg == "--stats=json") {
+        stats_format = "json";
+    } else if (arg == "--dedup" || arg == "--dedup=hardlink") {
+        options.dedup = true;
+        options.link_mode = LinkMode::HARDLINK;
+    } else if (arg == "--dedup=reflink") {
+        options.dedup = true;
+        options.link_mode = LinkMode::REFLINK;
+    } else if (arg == "--dedup=copy") {
+        options.dedup = true;
+        options.link_mode = LinkMode::COPY;
+    } else if (arg == "-q" || arg == "--progress=quiet") {
+        options.progress = Progress::Mode::QUIET;
+    } else if (arg == "--progress" || arg == "--progress=summary") {
+        options.progress = Progress::Mode::SUMMARY;
+    } else if (arg == "--progress=files") {
+        options.progress = Progress::Mode::FILES;
+    } else if (arg == "--progress=json") {
+        options.progress = Progress::Mode::JSON;
+    } else if (arg == "-j" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.jobs = unsigned(stoul(subargs[0]));
+    } else if (arg == "--max-memory" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.max_memory = stoull(subargs[0]) << 20;
+    } else if (arg == "--max-entry-size" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.limits.max_entry_size = stoull(subargs[0]) << 20;
+    } else if (arg == "--max-total" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.limits.max_total_size = stoull(subargs[0]) << 20;
+    } else if (arg == "--max-ratio" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.limits.max_ratio = uint32_t(stoul(subargs[0]));
+    } else if (arg == "--time-limit" && subargs.size() >= 2) {
+        subargs.pop_front();
+        options.limits.max_time = chrono::seconds(stoul(subargs[0]));
+    } else if (arg == "--store" && subargs.size() >= 2) {
+        subargs.pop_front();
+        store_dir = subargs[0];
+    } else {
+        return false;
+    }
+    subargs.pop_front();
+    return true;
+}
+
 int cmd_extract(deque<string> subargs) {
     fs::path apath;
     fs::path destdir;
+    uint64_t offset = 0;
+    string stats_format;
 
-    if (subargs.size() != 2) {
+    ExtractOptions options;
+    fs::path store_dir;
+    fs::path list_path;
+
+    while (subargs.size() && subargs[0].rfind("-", 0) == 0) {
+        if (subargs[0] == "-o" && parse_offset(subargs, offset)) {
+            continue;
+        } else if (subargs[0] == "--only" && subargs.size() >= 2) {
+            list_path = subargs[1];
+            subargs.pop_front();
+            subargs.pop_front();
+        } else if (!parse_extract_option(subargs, options, store_dir, stats_format)) {
+            return cmd_help();
+        }
+    }
+    if (subargs.size() != 2 && !(subargs.size() == 3 && list_path.empty())) {
         return cmd_help();
     }
+    unique_ptr<BlobStore> store;
+    if (!store_dir.empty()) {
+        store = make_unique<BlobStore>(store_dir, options.link_mode);
+        options.store = store.get();
+    }
 
     apath = subargs[0];
     destdir = subargs[1];
@@ -184,11 +863,352 @@ int cmd_extract(deque<string> subargs) {
         cerr << "Archive not found: " << apath << endl;
         return 1;
     }
-    ISArchiveV3 archive(apath);
-    return extract(archive, destdir) ? 0 : 1;
+    unique_ptr<Stats> stats;
+    if (!stats_format.empty()) {
+        stats = make_unique<Stats>();
+    }
+    bool ok;
+    if (offset == 0 && PackArchive::isPack(apath)) {
+        PackArchive pack(apath);
+        vector<const PackArchive::Entry*> entries;
+        if (!list_path.empty()) {
+            auto lookup = [&pack](const string& path) {
+                return pack.file(path);
+            };
+            if (!read_entry_list(list_path, lookup, entries)) {
+                return 1;
+            }
+        } else if (!select_packed(pack, subargs.size() == 3 ? subargs[2] : "", entries)) {
+            return 1;
+        }
+        ok = extract_packed(pack, entries, destdir, options, stats.get());
+    } else {
+        auto archive = open_for_extract(apath, offset, stats.get(), options);
+        if (subargs.size() == 3 && !(options.directory = find_directory(*archive, subargs[2]))) {
+            return 1;
+        }
+        vector<const ISArchiveV3::File*> only;
+        if (!list_path.empty()) {
+            auto lookup = [&archive](const string& path) {
+                return archive->file(path);
+            };
+            if (!read_entry_list(list_path, lookup, only)) {
+                return 1;
+            }
+            options.only = &only;
+        }
+        ok = extract(*archive, destdir, options);
+    }
+    if (stats_format == "json") {
+        stats->printJson(cerr);
+    } else if (stats) {
+        stats->print(cerr);
+    }
+    return ok ? 0 : 1;
 }
 
-int main(int argc, char** argv) {
+int cmd_extract_many(deque<string> subargs) {
+    string stats_format;
+    ExtractOptions options;
+    fs::path store_dir;
+
+    while (subargs.size() && subargs[0].rfind("-", 0) == 0) {
+        if (!parse_extract_option(subargs, options, store_dir, stats_format)) {
+            return cmd_help();
+        }
+    }
+    if (subargs.size() < 2) {
+        return cmd_help();
+    }
+    unique_ptr<BlobStore> store;
+    if (!store_dir.empty()) {
+        store = make_unique<BlobStore>(store_dir, options.link_mode);
+        options.store = store.get();
+    }
+    fs::path destdir = subargs[0];
+    subargs.pop_front();
+    if (!fs::exists(destdir)) {
+        cerr << "Destination directory not found: " << destdir << endl;
+        return 1;
+    }
+
+    unique_ptr<Stats> stats;
+    if (!stats_format.empty()) {
+        stats = make_unique<Stats>();
+    }
+    for (const auto& apath : subargs) {
+        if (!fs::exists(apath)) {
+            cerr << "Archive not found: " << apath << endl;
+            return 1;
+        }
+        fs::path archive_dest = destdir / fs::path(apath).filename();
+        fs::create_directories(archive_dest);
+        auto archive = open_for_extract(apath, 0, stats.get(), options);
+        if (!extract(*archive, archive_dest, options)) {
+            return 1;
+        }
+    }
+    if (stats_format == "json") {
+        stats->printJson(cerr);
+    } else if (stats) {
+        stats->print(cerr);
+    }
+    return 0;
+}
+
+// `read` from a pack: a view into the mapping, no decoding.
+int read_packed(const fs::path& ppath, const string& entry, uint64_t start, size_t length) {
+    PackArchive pack(ppath);
+    const PackArchive::Entry* e = pack.file(entry);
+    if (e == nullptr) {
+        cerr << "File not found in archive: " << entry << endl;
+        return 1;
+    }
+    if (start < e->size) {
+        length = size_t(min<uint64_t>(length, e->size - start));
+        cout.write(reinterpret_cast<const char*>(pack.data(*e) + start), streamsize(length));
+    }
+    return cout.fail() ? 1 : 0;
+}
+
+int cmd_read(deque<string> subargs) {
+    uint64_t offset = 0;
+    fs::path index_path;
+    uint32_t interval_kb = 256;
+
+    while (subargs.size() && subargs[0].rfind("-", 0) == 0) {
+        if (subargs[0] == "-o" && parse_offset(subargs, offset)) {
+            continue;
+        } else if (subargs[0] == "--index" && subargs.size() >= 2) {
+            index_path = subargs[1];
+            subargs.pop_front();
+            subargs.pop_front();
+        } else if (subargs[0] == "--interval" && subargs.size() >= 2) {
+            interval_kb = uint32_t(stoul(subargs[1]));
+            subargs.pop_front();
+            subargs.pop_front();
+        } else {
+            return cmd_help();
+        }
+    }
+    if (subargs.size() != 4 || interval_kb == 0) {
+        return cmd_help();
+    }
+    if (!fs::exists(subargs[0])) {
+        cerr << "Archive not found: " << subargs[0] << endl;
+        return 1;
+    }
+    string entry = subargs[1];
+    replace(entry.begin(), entry.end(), '/', '\\');
+    uint64_t start = stoull(subargs[2], nullptr, 0);
+    size_t length = size_t(stoull(subargs[3], nullptr, 0));
+    if (offset == 0 && PackArchive::isPack(subargs[0])) {
+        return read_packed(subargs[0], entry, start, length);
+    }
+
+    ISArchiveV3 archive(make_shared<const MappedFile>(subargs[0]), offset);
+    const ISArchiveV3::File* file = archive.file(entry);
+    if (file == nullptr) {
+        cerr << "File not found in archive: " << entry << endl;
+        return 1;
+    }
+
+    // Reuse a saved index if it still describes this entry.
+    SeekIndex index;
+    if (!index_path.empty()) {
+        if (fs::exists(index_path)) {
+            index = SeekIndex::load(index_path);
+        }
+        if (!index.matches(*file)) {
+            index = archive.buildSeekIndex(*file, interval_kb * 1024);
+            index.save(index_path);
+        }
+    }
+    auto data = archive.readAt(*file, start, length, index_path.empty() ? nullptr : &index);
+    cout.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+    return cout.fail() ? 1 : 0;
+}
+
+int cmd_pack(deque<string> subargs) {
+    uint64_t offset = 0;
+    if (!parse_offset(subargs, offset) || subargs.size() != 2) {
+        return cmd_help();
+    }
+    if (!fs::exists(subargs[0])) {
+        cerr << "Archive not found: " << subargs[0] << endl;
+        return 1;
+    }
+    ISArchiveV3 archive(make_shared<const MappedFile>(subargs[0]), offset);
+    PackArchive::build(archive, subargs[1]);
+    PackArchive pack(subargs[1]);
+    cout << pack.entryCount() << " entries, " << pack.header().data_size << " bytes packed into "
+         << subargs[1] << endl;
+    return 0;
+}
+
+int cmd_diff(deque<string> subargs) {
+    if (subargs.size() != 2) {
+        return cmd_help();
+    }
+    for (const auto& apath : subargs) {
+        if (!fs::exists(apath)) {
+            cerr << "Archive not found: " << apath << endl;
+            return 1;
+        }
+    }
+    ISArchiveV3 old_archive(make_shared<const MappedFile>(subargs[0]));
+    ISArchiveV3 new_archive(make_shared<const MappedFile>(subargs[1]));
+    diff_archives(old_archive, new_archive);
+    return 0;
+}
+
+int cmd_mount(deque<string> subargs) {
+#ifdef HAVE_FUSE
+    uint64_t offset = 0;
+    uint64_t cache_mb = 256;
+    bool foreground = false;
+
+    while (subargs.size() && subargs[0].rfind("-", 0) == 0) {
+        if (subargs[0] == "-o" && parse_offset(subargs, offset)) {
+            continue;
+        } else if (subargs[0] == "-f") {
+            foreground = true;
+            subargs.pop_front();
+        } else if (subargs[0] == "--cache" && subargs.size() >= 2) {
+            cache_mb = stoull(subargs[1]);
+            subargs.pop_front();
+            subargs.pop_front();
+        } else {
+            return cmd_help();
+        }
+    }
+    if (subargs.size() != 2) {
+        return cmd_help();
+    }
+    if (!fs::exists(subargs[0])) {
+        cerr << "Archive not found: " << subargs[0] << endl;
+        return 1;
+    }
+    ISArchiveV3 archive(make_shared<const MappedFile>(subargs[0]), offset);
+    return mountArchive(archive, subargs[1], cache_mb << 20, foreground);
+#else
+    (void)subargs;
+    cerr << "unshieldv3 was built without FUSE support." << endl;
+    return 1;
+#endif
+}
+
+int cmd_serve(deque<string> subargs) {
+#ifndef _WIN32
+    unsigned jobs = std::thread::hardware_concurrency();
+    uint64_t cache_mb = 256;
+    size_t max_archives = 64;
+
+    while (subargs.size() >= 2 && subargs[0].rfind("-", 0) == 0) {
+        if (subargs[0] == "-j") {
+            jobs = unsigned(stoul(subargs[1]));
+        } else if (subargs[0] == "--cache") {
+            cache_mb = stoull(subargs[1]);
+        } else if (subargs[0] == "--archives") {
+            max_archives = stoul(subargs[1]);
+        } else {
+            return cmd_help();
+        }
+        subargs.pop_front();
+        subargs.pop_front();
+    }
+    if (subargs.size() != 1 || jobs == 0 || max_archives == 0) {
+        return cmd_help();
+    }
+    ArchiveServer server(subargs[0], jobs, cache_mb << 20, max_archives);
+    server.run();
+    return 0;
+#else
+    (void)subargs;
+    cerr << "serve is not supported on this platform." << endl;
+    return 1;
+#endif
+}
+
+int cmd_index(deque<string> subargs) {
+    unsigned jobs = std::thread::hardware_concurrency();
+
+    if (subargs.size() >= 2 && subargs[0] == "-j") {
+        jobs = unsigned(stoul(subargs[1]));
+        subargs.pop_front();
+        subargs.pop_front();
+    }
+    if (subargs.size() < 2 || jobs == 0) {
+        return cmd_help();
+    }
+
+    fs::path catalog_path = subargs[0];
+    subargs.pop_front();
+    vector<fs::path> archives;
+    for (const auto& arg : subargs) {
+        if (fs::is_directory(arg)) {
+            for (const auto& de : fs::recursive_directory_iterator(arg)) {
+                if (de.is_regular_file()) {
+                    archives.push_back(de.path());
+                }
+            }
+        } else if (fs::exists(arg)) {
+            archives.push_back(arg);
+        } else {
+            cerr << "Not found: " << arg << endl;
+            return 1;
+        }
+    }
+
+    auto result = Catalog::build(catalog_path, archives, jobs, cerr);
+    cout << "Indexed " << result.scanned << " archives ("
+        << result.reused << " unchanged), "
+        << result.entries << " entries";
+    if (result.failed) {
+        cout << ", " << result.failed << " failed";
+    }
+    cout << endl;
+    return result.failed ? 1 : 0;
+}
+
+int cmd_find(deque<string> subargs) {
+    if (subargs.size() < 2) {
+        return cmd_help();
+    }
+    if (!fs::exists(subargs[0])) {
+        cerr << "Catalog not found: " << subargs[0] << endl;
+        return 1;
+    }
+    Catalog catalog(subargs[0]);
+    for (size_t i = 1; i < subargs.size(); i++) {
+        find_in_catalog(catalog, subargs[i]);
+    }
+    return 0;
+}
+
+int cmd_scan(deque<string> subargs) {
+    if (subargs.size() == 0) {
+        return cmd_help();
+    }
+    for (const auto& path : subargs) {
+        if (!fs::exists(path)) {
+            cerr << "File not found: " << path << endl;
+            return 1;
+        }
+        MappedFile file(path);
+        for (uint64_t offset : Scanner::findArchives(file.data(), file.size())) {
+            ISArchiveV3::Header hdr;
+            memcpy(&hdr, file.data() + offset, sizeof(hdr));
+            cout << path << "\t" << offset
+                << "\t" << hdr.file_count << " files"
+                << "\t" << hdr.compressed_size << " bytes"
+                << "\n";
+        }
+    }
+    return 0;
+}
+
+int run(int argc, char** argv) {
     vector<string> args;
     for (int i = 0; i < argc; i++) {
         args.push_back(argv[i]);
@@ -215,6 +1235,51 @@ int main(int argc, char** argv) {
         return cmd_extract(subargs);
     }
 
+    if (args[1] == "extract-many") {
+        return cmd_extract_many(subargs);
+    }
+
+    if (args[1] == "read") {
+        return cmd_read(subargs);
+    }
+
+    if (args[1] == "diff") {
+        return cmd_diff(subargs);
+    }
+
+    if (args[1] == "pack") {
+        return cmd_pack(subargs);
+    }
+
+    if (args[1] == "mount") {
+        return cmd_mount(subargs);
+    }
+
+    if (args[1] == "serve") {
+        return cmd_serve(subargs);
+    }
+
+    if (args[1] == "scan") {
+        return cmd_scan(subargs);
+    }
+
+    if (args[1] == "index") {
+        return cmd_index(subargs);
+    }
+
+    if (args[1] == "find") {
+        return cmd_find(subargs);
+    }
+
     cmd_help();
     return 1;
 }
+
+int main(int argc, char** argv) {
+    try {
+        return run(argc, argv);
+    } catch (const std::exception& e) {
+        cerr << "Error: " << e.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,191 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+/* Test of the C interface in unshieldv3.h, run by ctest as
+ *   capi <test-data directory>
+ */
+#include "unshieldv3.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *levels[] = { "No", "Fast", "Medium", "High" };
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+static void *read_file(const char *path, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = (size_t)ftell(f);
+    fseek(f, 0, SEEK_SET);
+    void *data = malloc(*size);
+    if (data != NULL && fread(data, 1, *size, f) != *size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+/* Decompress entry `index` into a new buffer. */
+static unsigned char *decompress(unshieldv3_archive *archive, size_t index, size_t *size) {
+    unshieldv3_entry entry;
+    if (unshieldv3_entry_at(archive, index, &entry) != UNSHIELDV3_OK) {
+        return NULL;
+    }
+    unsigned char *buf = malloc(entry.uncompressed_size + 1);
+    if (unshieldv3_decompress(archive, index, buf, entry.uncompressed_size, size) != UNSHIELDV3_OK) {
+        fprintf(stderr, "%s: %s\n", entry.path, unshieldv3_error(archive));
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
+
+static int count_bytes(void *ctx, const void *data, size_t len) {
+    (void)data;
+    *(size_t *)ctx += len;
+    return 0;
+}
+
+static int abort_write(void *ctx, const void *data, size_t len) {
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return 1;
+}
+
+/* Fail on another thread; the message must not replace the main thread's. */
+static void *fail_elsewhere(void *arg) {
+    unshieldv3_archive *archive = arg;
+    char buf[1];
+    size_t written;
+    CHECK(unshieldv3_decompress(archive, 0, buf, sizeof(buf), &written) == UNSHIELDV3_E_BUFFER);
+    CHECK(strcmp(unshieldv3_error(archive), "Output buffer too small") == 0);
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: capi TEST-DATA-DIR\n");
+        return 2;
+    }
+    char path[4096];
+    unshieldv3_archive *archive = NULL;
+
+    CHECK(unshieldv3_version() != NULL);
+
+    snprintf(path, sizeof(path), "%s/no-such-archive.Z", argv[1]);
+    CHECK(unshieldv3_open_path(path, 0, &archive) == UNSHIELDV3_E_IO);
+    CHECK(strlen(unshieldv3_error(archive)) > 0);
+    unshieldv3_close(archive);
+
+    /* The uncompressed archive is the reference for the others. */
+    snprintf(path, sizeof(path), "%s/TestArchive1-NoCompression.Z", argv[1]);
+    CHECK(unshieldv3_open_path(path, 0, &archive) == UNSHIELDV3_OK);
+    CHECK(unshieldv3_entry_count(archive) == 3);
+    size_t sizes[3];
+    unsigned char *expected[3];
+    for (size_t i = 0; i < 3; i++) {
+        expected[i] = decompress(archive, i, &sizes[i]);
+        CHECK(expected[i] != NULL);
+    }
+    if (failures) {
+        return 1;
+    }
+    CHECK(sizes[0] == 407 && memcmp(expected[0], "This is a simple", 16) == 0);
+
+    unshieldv3_entry entry;
+    CHECK(unshieldv3_entry_at(archive, 1, &entry) == UNSHIELDV3_OK);
+    CHECK(strcmp(entry.path, "Images\\Apache-icon.png") == 0);
+    CHECK(strcmp(entry.name, "Apache-icon.png") == 0);
+    CHECK(entry.uncompressed_size == 11864);
+    CHECK(unshieldv3_entry_at(archive, 3, &entry) == UNSHIELDV3_E_NOT_FOUND);
+
+    size_t index = 0;
+    CHECK(unshieldv3_find(archive, "Text\\APACHE-LICENSE-2.0.txt", &index) == UNSHIELDV3_OK);
+    CHECK(index == 2);
+    CHECK(unshieldv3_find(archive, "no-such-entry", &index) == UNSHIELDV3_E_NOT_FOUND);
+
+    char small[10];
+    size_t written = 0;
+    CHECK(unshieldv3_decompress(archive, 0, small, sizeof(small), &written) == UNSHIELDV3_E_BUFFER);
+    CHECK(written == 407);
+
+    /* Errors are kept per thread. */
+    CHECK(unshieldv3_decompress(archive, 99, small, sizeof(small), &written) == UNSHIELDV3_E_NOT_FOUND);
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, fail_elsewhere, archive) == 0);
+    pthread_join(thread, NULL);
+    CHECK(strcmp(unshieldv3_error(archive), "Entry index out of range") == 0);
+    unshieldv3_close(archive);
+
+    /* Every compression level decodes to the same files, from a path, from
+     * memory and through a callback. */
+    for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); l++) {
+        snprintf(path, sizeof(path), "%s/TestArchive1-%sCompression.Z", argv[1], levels[l]);
+        size_t size;
+        void *data = read_file(path, &size);
+        CHECK(data != NULL);
+        if (data == NULL) {
+            continue;
+        }
+        unshieldv3_archive *archives[2] = { NULL, NULL };
+        CHECK(unshieldv3_open_path(path, 0, &archives[0]) == UNSHIELDV3_OK);
+        CHECK(unshieldv3_open_memory(data, size, &archives[1]) == UNSHIELDV3_OK);
+        for (size_t a = 0; a < 2; a++) {
+            for (size_t i = 0; i < 3; i++) {
+                size_t len = 0;
+                unsigned char *contents = decompress(archives[a], i, &len);
+                CHECK(contents != NULL && len == sizes[i] && memcmp(contents, expected[i], len) == 0);
+                free(contents);
+
+                size_t total = 0;
+                CHECK(unshieldv3_decompress_cb(archives[a], i, count_bytes, &total) == UNSHIELDV3_OK);
+                CHECK(total == sizes[i]);
+            }
+            CHECK(unshieldv3_decompress_cb(archives[a], 1, abort_write, NULL) == UNSHIELDV3_E_ABORTED);
+            unshieldv3_close(archives[a]);
+        }
+        free(data);
+    }
+
+    /* Decoding limits are reported as errors, not crashes. */
+    snprintf(path, sizeof(path), "%s/TestArchive1-Overrun.Z", argv[1]);
+    CHECK(unshieldv3_open_path(path, 0, &archive) == UNSHIELDV3_OK);
+    char buf[512];
+    CHECK(unshieldv3_decompress(archive, 0, buf, sizeof(buf), &written) == UNSHIELDV3_E_DECODE);
+    unshieldv3_close(archive);
+
+    for (size_t i = 0; i < 3; i++) {
+        free(expected[i]);
+    }
+    if (failures) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,434 @@
+# unshieldv3 -- extract InstallShield V3 archives.
+# Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+cmake_minimum_required(VERSION 3.5)
+
+# Command line tests over test-data/, run by ctest as
+#   cmake -DUNSHIELDV3=<binary> -DTEST_DATA=<dir> -DWORK_DIR=<dir> -DCASE=<name> -P cli.cmake
+#
+# TestArchive1-*Compression.Z hold the same three files at different
+# compression levels. The other archives are derived from them:
+#   Corrupt   HighCompression with the compressed size of README.txt forged
+#             to 0xFFFFFF00
+#   Overrun   HighCompression with the uncompressed size of README.txt
+#             lowered to 100
+#   Modified  NoCompression with README.txt changed ("This" -> "That") and
+#             Text\APACHE-LICENSE-2.0.txt renamed to 2.1
+#   Duplicate NoCompression with Text\APACHE-LICENSE-2.0.txt pointing at the
+#             stored bytes of README.txt
+#   Embedded  a 1000 byte stub, NoCompression, 777 zero bytes, HighCompression
+#             and 100 bytes of 0xFF, as in a self-extracting installer
+
+set(README_SHA256 adb119b6ba6c576b92ab318cfadd735b92a2bbdb0d9298f5746ccb8ea64f8bef)
+set(ICON_SHA256 b800ccc137e6dd27e188b47858480b3f26a28e84f448d12eed3aeda070abd6f7)
+set(LICENSE_SHA256 cfc7749b96f63bd31c3c42b5c471bf756814053e847c10f3eb003417bc523d30)
+set(LEVELS No Fast Medium High)
+
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Run unshieldv3 with the remaining arguments; fail unless it exits with 0.
+function(run)
+    execute_process(COMMAND ${UNSHIELDV3} ${ARGN}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE error)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "unshieldv3 ${ARGN} failed (${result}):\n${output}${error}")
+    endif()
+    set(OUTPUT "${output}" PARENT_SCOPE)
+endfunction()
+
+# Run unshieldv3; fail unless it exits with an error matching `pattern`.
+function(run_fails pattern)
+    execute_process(COMMAND ${UNSHIELDV3} ${ARGN}
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE error)
+    if (result EQUAL 0 OR NOT error MATCHES "${pattern}")
+        message(FATAL_ERROR "unshieldv3 ${ARGN}: expected an error matching \"${pattern}\", "
+            "got (${result}):\n${output}${error}")
+    endif()
+endfunction()
+
+function(expect_sha256 path expected)
+    if (NOT EXISTS ${path})
+        message(FATAL_ERROR "missing: ${path}")
+    endif()
+    file(SHA256 ${path} actual)
+    if (NOT actual STREQUAL expected)
+        message(FATAL_ERROR "${path}: SHA-256 ${actual}, expected ${expected}")
+    endif()
+endfunction()
+
+# Fail unless `dir` holds exactly the three files of TestArchive1.
+function(expect_extracted dir)
+    file(GLOB_RECURSE files RELATIVE ${dir} ${dir}/*)
+    list(LENGTH files count)
+    if (NOT count EQUAL 3)
+        message(FATAL_ERROR "${dir}: expected 3 files, found ${files}")
+    endif()
+    expect_sha256(${dir}/README.txt ${README_SHA256})
+    expect_sha256(${dir}/Images/Apache-icon.png ${ICON_SHA256})
+    expect_sha256(${dir}/Text/APACHE-LICENSE-2.0.txt ${LICENSE_SHA256})
+endfunction()
+
+# Extract every compression level, passing the arguments as options, and
+# check the output.
+function(extract_all)
+    foreach (level IN LISTS LEVELS)
+        set(dest ${WORK_DIR}/${level})
+        file(MAKE_DIRECTORY ${dest})
+        run(extract -q ${ARGN} ${TEST_DATA}/TestArchive1-${level}Compression.Z ${dest})
+        expect_extracted(${dest})
+    endforeach()
+endfunction()
+
+# Fail unless file `path` holds bytes [offset, offset + length) of `source`.
+function(expect_range path source offset length)
+    file(READ ${source} expected OFFSET ${offset} LIMIT ${length} HEX)
+    file(READ ${path} actual HEX)
+    if (NOT actual STREQUAL expected)
+        message(FATAL_ERROR "${path} differs from ${source} [${offset}, +${length})")
+    endif()
+endfunction()
+
+# Read `length` bytes of the icon at `offset` from every compression level,
+# passing the remaining arguments as options.
+function(read_all offset length)
+    foreach (level IN LISTS LEVELS)
+        set(out ${WORK_DIR}/${level}-${offset}.bin)
+        execute_process(COMMAND ${UNSHIELDV3} read ${ARGN}
+            ${TEST_DATA}/TestArchive1-${level}Compression.Z "Images\\Apache-icon.png" ${offset} ${length}
+            RESULT_VARIABLE result OUTPUT_FILE ${out} ERROR_VARIABLE error)
+        if (NOT result EQUAL 0)
+            message(FATAL_ERROR "read from ${level} failed (${result}): ${error}")
+        endif()
+        expect_range(${out} ${WORK_DIR}/baseline/Images/Apache-icon.png ${offset} ${length})
+    endforeach()
+endfunction()
+
+if (CASE STREQUAL "extract")
+    extract_all()
+elseif (CASE STREQUAL "extract_jobs")
+    extract_all(-j 4)
+elseif (CASE STREQUAL "extract_streaming")
+    # A 1 MB cap shared by 64 jobs leaves too little per entry for the two
+    # larger files, which are then streamed to disk.
+    extract_all(-j 64 --max-memory 1)
+elseif (CASE STREQUAL "read")
+    file(MAKE_DIRECTORY ${WORK_DIR}/baseline)
+    run(extract -q ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/baseline)
+    read_all(0 100)
+    read_all(9000 5000)
+    read_all(11800 1000)
+elseif (CASE STREQUAL "read_index")
+    file(MAKE_DIRECTORY ${WORK_DIR}/baseline)
+    run(extract -q ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/baseline)
+    # The first read builds the index, the others decode from checkpoints.
+    foreach (level IN LISTS LEVELS)
+        file(REMOVE ${WORK_DIR}/${level}.idx)
+    endforeach()
+    foreach (offset 0 5000 9000 11800)
+        foreach (level IN LISTS LEVELS)
+            set(out ${WORK_DIR}/${level}-${offset}.bin)
+            execute_process(COMMAND ${UNSHIELDV3} read --index ${WORK_DIR}/${level}.idx --interval 4
+                ${TEST_DATA}/TestArchive1-${level}Compression.Z "Images\\Apache-icon.png" ${offset} 3000
+                RESULT_VARIABLE result OUTPUT_FILE ${out} ERROR_VARIABLE error)
+            if (NOT result EQUAL 0)
+                message(FATAL_ERROR "read --index from ${level} failed (${result}): ${error}")
+            endif()
+            expect_range(${out} ${WORK_DIR}/baseline/Images/Apache-icon.png ${offset} 3000)
+        endforeach()
+    endforeach()
+    if (NOT EXISTS ${WORK_DIR}/High.idx)
+        message(FATAL_ERROR "no index was written")
+    endif()
+elseif (CASE STREQUAL "pack")
+    file(MAKE_DIRECTORY ${WORK_DIR}/baseline)
+    run(extract -q ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/baseline)
+    foreach (level IN LISTS LEVELS)
+        set(pack ${WORK_DIR}/${level}.pack)
+        run(pack ${TEST_DATA}/TestArchive1-${level}Compression.Z ${pack})
+        foreach (entry README.txt Images/Apache-icon.png Text/APACHE-LICENSE-2.0.txt)
+            string(REPLACE "/" "\\" archive_path ${entry})
+            set(out ${WORK_DIR}/${level}.out)
+            execute_process(COMMAND ${UNSHIELDV3} read ${pack} ${archive_path} 0 1000000
+                RESULT_VARIABLE result OUTPUT_FILE ${out} ERROR_VARIABLE error)
+            if (NOT result EQUAL 0)
+                message(FATAL_ERROR "read from ${pack} failed (${result}): ${error}")
+            endif()
+            file(SHA256 ${WORK_DIR}/baseline/${entry} expected)
+            expect_sha256(${out} ${expected})
+        endforeach()
+
+        # info, list and extract take packs as well.
+        run(info ${pack})
+        if (NOT OUTPUT MATCHES "File count: 3\nCompressed size: [0-9]+\nUncompressed size: 23629\n")
+            message(FATAL_ERROR "info ${pack}:\n${OUTPUT}")
+        endif()
+        run(list -v ${pack})
+        if (NOT OUTPUT MATCHES "Images\\\\Apache-icon.png +11864  2022-04-16 19:00:24")
+            message(FATAL_ERROR "list -v ${pack}:\n${OUTPUT}")
+        endif()
+        run(list ${pack} Text)
+        if (NOT OUTPUT STREQUAL "Text\\APACHE-LICENSE-2.0.txt\n")
+            message(FATAL_ERROR "list ${pack} Text:\n${OUTPUT}")
+        endif()
+        run_fails("Directory not found in archive: Nope" list ${pack} Nope)
+        set(dest ${WORK_DIR}/${level})
+        file(MAKE_DIRECTORY ${dest})
+        run(extract -q ${pack} ${dest})
+        expect_extracted(${dest})
+        file(MAKE_DIRECTORY ${dest}-images)
+        run(extract -q ${pack} ${dest}-images Images)
+        file(GLOB_RECURSE files RELATIVE ${dest}-images ${dest}-images/*)
+        if (NOT files STREQUAL "Images/Apache-icon.png")
+            message(FATAL_ERROR "extract ${pack} Images wrote: ${files}")
+        endif()
+        file(WRITE ${WORK_DIR}/only.txt "README.txt\n")
+        file(MAKE_DIRECTORY ${dest}-only)
+        run(extract -q --only ${WORK_DIR}/only.txt ${pack} ${dest}-only)
+        file(GLOB_RECURSE files RELATIVE ${dest}-only ${dest}-only/*)
+        if (NOT files STREQUAL "README.txt")
+            message(FATAL_ERROR "extract --only from ${pack} wrote: ${files}")
+        endif()
+    endforeach()
+elseif (CASE STREQUAL "diff_only")
+    run(diff ${TEST_DATA}/TestArchive1-NoCompression.Z ${TEST_DATA}/TestArchive1-Modified.Z)
+    file(WRITE ${WORK_DIR}/changes.txt "${OUTPUT}")
+    foreach (line "M\tREADME.txt" "A\tText\\\\APACHE-LICENSE-2.1.txt" "D\tText\\\\APACHE-LICENSE-2.0.txt")
+        if (NOT OUTPUT MATCHES "${line}\n")
+            message(FATAL_ERROR "diff output lacks \"${line}\":\n${OUTPUT}")
+        endif()
+    endforeach()
+    if (OUTPUT MATCHES "Apache-icon")
+        message(FATAL_ERROR "diff reports an unchanged entry:\n${OUTPUT}")
+    endif()
+    run(diff ${TEST_DATA}/TestArchive1-NoCompression.Z ${TEST_DATA}/TestArchive1-HighCompression.Z)
+    if (OUTPUT MATCHES "^[ADM]\t|\n[ADM]\t")
+        message(FATAL_ERROR "diff reports changes between equal contents:\n${OUTPUT}")
+    endif()
+
+    file(MAKE_DIRECTORY ${WORK_DIR}/only)
+    run(extract -q --only ${WORK_DIR}/changes.txt ${TEST_DATA}/TestArchive1-Modified.Z ${WORK_DIR}/only)
+    file(GLOB_RECURSE files RELATIVE ${WORK_DIR}/only ${WORK_DIR}/only/*)
+    list(SORT files)
+    if (NOT files STREQUAL "README.txt;Text/APACHE-LICENSE-2.1.txt")
+        message(FATAL_ERROR "extract --only wrote: ${files}")
+    endif()
+    expect_sha256(${WORK_DIR}/only/Text/APACHE-LICENSE-2.1.txt ${LICENSE_SHA256})
+    file(READ ${WORK_DIR}/only/README.txt readme LIMIT 4 HEX)
+    if (NOT readme STREQUAL "54686174") # "That"
+        message(FATAL_ERROR "extract --only wrote the old README.txt")
+    endif()
+elseif (CASE STREQUAL "store")
+    # Rewriting a file that came from the store or from --dedup=hardlink
+    # must change neither the store nor the entries it was linked to.
+    run(diff ${TEST_DATA}/TestArchive1-NoCompression.Z ${TEST_DATA}/TestArchive1-Modified.Z)
+    file(WRITE ${WORK_DIR}/changes.txt "${OUTPUT}")
+    foreach (dir first second third)
+        file(MAKE_DIRECTORY ${WORK_DIR}/${dir})
+    endforeach()
+    run(extract -q --store ${WORK_DIR}/store ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/first)
+    run(extract -q --store ${WORK_DIR}/store ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/second)
+    expect_extracted(${WORK_DIR}/second)
+    run(extract -q --store ${WORK_DIR}/store --only ${WORK_DIR}/changes.txt
+        ${TEST_DATA}/TestArchive1-Modified.Z ${WORK_DIR}/second)
+    run(extract -q --store ${WORK_DIR}/store ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/third)
+    expect_extracted(${WORK_DIR}/first)
+    expect_extracted(${WORK_DIR}/third)
+
+    file(MAKE_DIRECTORY ${WORK_DIR}/dedup)
+    run(extract -q --dedup=hardlink ${TEST_DATA}/TestArchive1-Duplicate.Z ${WORK_DIR}/dedup)
+    expect_sha256(${WORK_DIR}/dedup/Text/APACHE-LICENSE-2.0.txt ${README_SHA256})
+    run(extract -q --dedup=hardlink --only ${WORK_DIR}/changes.txt
+        ${TEST_DATA}/TestArchive1-Modified.Z ${WORK_DIR}/dedup)
+    expect_sha256(${WORK_DIR}/dedup/Text/APACHE-LICENSE-2.0.txt ${README_SHA256})
+elseif (CASE STREQUAL "index_find")
+    set(archives)
+    foreach (level IN LISTS LEVELS)
+        list(APPEND archives ${TEST_DATA}/TestArchive1-${level}Compression.Z)
+    endforeach()
+    run(index -j 2 ${WORK_DIR}/catalog ${archives})
+    if (NOT OUTPUT STREQUAL "Indexed 4 archives (0 unchanged), 12 entries\n")
+        message(FATAL_ERROR "index: ${OUTPUT}")
+    endif()
+    # Unchanged archives are carried over from the existing catalog.
+    run(index -j 2 ${WORK_DIR}/catalog ${archives})
+    if (NOT OUTPUT STREQUAL "Indexed 4 archives (4 unchanged), 12 entries\n")
+        message(FATAL_ERROR "index again: ${OUTPUT}")
+    endif()
+    run(find ${WORK_DIR}/catalog APACHE-LICENSE-2.0.txt no-such-entry)
+    foreach (level IN LISTS LEVELS)
+        if (NOT OUTPUT MATCHES "TestArchive1-${level}Compression.Z\tText\\\\APACHE-LICENSE-2.0.txt\t11358\t")
+            message(FATAL_ERROR "find lacks ${level}:\n${OUTPUT}")
+        endif()
+    endforeach()
+    string(REGEX MATCHALL "\n" lines "${OUTPUT}")
+    list(LENGTH lines count)
+    if (NOT count EQUAL 4)
+        message(FATAL_ERROR "find: expected 4 matches, got:\n${OUTPUT}")
+    endif()
+elseif (CASE STREQUAL "scan")
+    set(embedded ${TEST_DATA}/TestArchive1-Embedded.bin)
+    run(scan ${embedded} ${TEST_DATA}/TestArchive1-NoCompression.Z)
+    set(expected
+        "${embedded}\t1000\t3 files\t24103 bytes\n"
+        "${embedded}\t25880\t3 files\t18130 bytes\n"
+        "${TEST_DATA}/TestArchive1-NoCompression.Z\t0\t3 files\t24103 bytes\n")
+    string(CONCAT expected ${expected})
+    if (NOT OUTPUT STREQUAL expected)
+        message(FATAL_ERROR "scan:\n${OUTPUT}")
+    endif()
+    # Both offsets open, in decimal or hex; others do not.
+    foreach (offset 1000 0x6518)
+        file(MAKE_DIRECTORY ${WORK_DIR}/${offset})
+        run(extract -o ${offset} -q ${embedded} ${WORK_DIR}/${offset})
+        expect_extracted(${WORK_DIR}/${offset})
+    endforeach()
+    run(list -o 0x3e8 ${embedded})
+    if (NOT OUTPUT STREQUAL "README.txt\nImages\\Apache-icon.png\nText\\APACHE-LICENSE-2.0.txt\n")
+        message(FATAL_ERROR "list -o:\n${OUTPUT}")
+    endif()
+    run_fails("Not an InstallShield V3 archive" info -o 1001 ${embedded})
+    run_fails("Not an InstallShield V3 archive" list ${embedded})
+elseif (CASE STREQUAL "stats")
+    # Statistics go to stderr, after the extracted files.
+    file(MAKE_DIRECTORY ${WORK_DIR}/json ${WORK_DIR}/text)
+    execute_process(COMMAND ${UNSHIELDV3} extract -q --stats=json
+        ${TEST_DATA}/TestArchive1-HighCompression.Z ${WORK_DIR}/json
+        RESULT_VARIABLE result ERROR_VARIABLE stats)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "extract --stats=json failed (${result}): ${stats}")
+    endif()
+    expect_extracted(${WORK_DIR}/json)
+    foreach (field "\"entries\": 3," "\"bytes_in\": 17656," "\"bytes_out\": 23629,"
+            "\"syscalls\": ([1-9][0-9]*|null)," "\"decode_ms\": [0-9]+\\.[0-9][0-9][0-9],")
+        if (NOT stats MATCHES "${field}")
+            message(FATAL_ERROR "--stats=json lacks ${field}: ${stats}")
+        endif()
+    endforeach()
+    execute_process(COMMAND ${UNSHIELDV3} extract -q --stats
+        ${TEST_DATA}/TestArchive1-HighCompression.Z ${WORK_DIR}/text
+        RESULT_VARIABLE result ERROR_VARIABLE stats)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "extract --stats failed (${result}): ${stats}")
+    endif()
+    foreach (field "entries: +3\n" "bytes_out: +23629\n" "syscalls: +([1-9][0-9]*|unavailable)\n"
+            "total: +[0-9.]+ ms")
+        if (NOT stats MATCHES "${field}")
+            message(FATAL_ERROR "--stats lacks ${field}: ${stats}")
+        endif()
+    endforeach()
+elseif (CASE STREQUAL "subtree")
+    set(archive ${TEST_DATA}/TestArchive1-NoCompression.Z)
+    run(list ${archive} Text)
+    if (NOT OUTPUT STREQUAL "Text\\APACHE-LICENSE-2.0.txt\n")
+        message(FATAL_ERROR "list Text:\n${OUTPUT}")
+    endif()
+    # A trailing separator names the same directory, "/" is accepted as one.
+    foreach (dir "Images\\" "Images/")
+        run(list ${archive} ${dir})
+        if (NOT OUTPUT STREQUAL "Images\\Apache-icon.png\n")
+            message(FATAL_ERROR "list ${dir}:\n${OUTPUT}")
+        endif()
+    endforeach()
+    run(list ${archive} "")
+    if (NOT OUTPUT STREQUAL "README.txt\nImages\\Apache-icon.png\nText\\APACHE-LICENSE-2.0.txt\n")
+        message(FATAL_ERROR "list of the root:\n${OUTPUT}")
+    endif()
+    run_fails("Directory not found in archive: Nope" list ${archive} Nope)
+
+    foreach (level IN LISTS LEVELS)
+        set(dest ${WORK_DIR}/${level})
+        file(MAKE_DIRECTORY ${dest})
+        run(extract -q ${TEST_DATA}/TestArchive1-${level}Compression.Z ${dest} Images)
+        file(GLOB_RECURSE files RELATIVE ${dest} ${dest}/*)
+        if (NOT files STREQUAL "Images/Apache-icon.png")
+            message(FATAL_ERROR "extract Images from ${level} wrote: ${files}")
+        endif()
+        expect_sha256(${dest}/Images/Apache-icon.png ${ICON_SHA256})
+    endforeach()
+    run_fails("Directory not found in archive: Nope" extract -q ${archive} ${WORK_DIR} Nope)
+elseif (CASE STREQUAL "progress")
+    set(archive ${TEST_DATA}/TestArchive1-HighCompression.Z)
+    file(MAKE_DIRECTORY ${WORK_DIR}/out)
+    set(json_lines
+        "{\"path\": \"README.txt\", \"compressed_size\": 211, \"size\": 407}\n"
+        "{\"path\": \"Images\\\\Apache-icon.png\", \"compressed_size\": 13019, \"size\": 11864}\n"
+        "{\"path\": \"Text\\\\APACHE-LICENSE-2.0.txt\", \"compressed_size\": 4426, \"size\": 11358}\n")
+    string(CONCAT json ${json_lines})
+
+    foreach (mode -q --progress=quiet)
+        execute_process(COMMAND ${UNSHIELDV3} extract ${mode} ${archive} ${WORK_DIR}/out
+            RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE error)
+        if (NOT result EQUAL 0 OR NOT output STREQUAL "" OR NOT error STREQUAL "")
+            message(FATAL_ERROR "extract ${mode} printed (${result}):\n${output}${error}")
+        endif()
+    endforeach()
+
+    run(extract --progress=json ${archive} ${WORK_DIR}/out)
+    if (NOT OUTPUT STREQUAL json)
+        message(FATAL_ERROR "--progress=json:\n${OUTPUT}")
+    endif()
+    # Parallel extraction reports the same entries in any order.
+    run(extract -j 4 --progress=json ${archive} ${WORK_DIR}/out)
+    string(REPLACE "\n" ";" lines "${OUTPUT}")
+    list(SORT lines)
+    string(REPLACE "\n" ";" expected_lines "${json}")
+    list(SORT expected_lines)
+    if (NOT lines STREQUAL expected_lines)
+        message(FATAL_ERROR "-j 4 --progress=json:\n${OUTPUT}")
+    endif()
+
+    # Linked entries name their origin.
+    file(MAKE_DIRECTORY ${WORK_DIR}/dedup)
+    run(extract --dedup --progress=json ${TEST_DATA}/TestArchive1-Duplicate.Z ${WORK_DIR}/dedup)
+    if (NOT OUTPUT MATCHES "\"Text\\\\\\\\APACHE-LICENSE-2.0.txt\", [^\n]*\"duplicate_of\": \"README.txt\"}\n")
+        message(FATAL_ERROR "--dedup --progress=json:\n${OUTPUT}")
+    endif()
+    foreach (dir first second)
+        file(MAKE_DIRECTORY ${WORK_DIR}/${dir})
+        run(extract --store ${WORK_DIR}/store --progress=json ${archive} ${WORK_DIR}/${dir})
+    endforeach()
+    if (NOT OUTPUT MATCHES "\"path\": \"README.txt\", [^\n]*\"store_key\": \"[0-9a-f]+-211-407\"}\n")
+        message(FATAL_ERROR "--store --progress=json:\n${OUTPUT}")
+    endif()
+
+    run(extract --progress=files ${archive} ${WORK_DIR}/out)
+    if (NOT OUTPUT MATCHES "^README.txt\n      Compressed size: +211\n    Uncompressed size: +407\n")
+        message(FATAL_ERROR "--progress=files:\n${OUTPUT}")
+    endif()
+    # The summary goes to stderr, entries are not listed.
+    execute_process(COMMAND ${UNSHIELDV3} extract --progress ${archive} ${WORK_DIR}/out
+        RESULT_VARIABLE result OUTPUT_VARIABLE output ERROR_VARIABLE error)
+    if (NOT result EQUAL 0 OR NOT output STREQUAL ""
+            OR NOT error MATCHES "^3 entries, [0-9.]+ MB in [0-9.]+ s \\([0-9.]+ MB/s\\)\n$")
+        message(FATAL_ERROR "--progress printed (${result}):\n${output}${error}")
+    endif()
+elseif (CASE STREQUAL "limits")
+    run_fails("Entry extends past the end of the archive: README.txt"
+        list ${TEST_DATA}/TestArchive1-Corrupt.Z)
+    run_fails("Entry extends past the end of the archive: README.txt"
+        extract -q --max-entry-size 1 ${TEST_DATA}/TestArchive1-Corrupt.Z ${WORK_DIR})
+    run_fails("Entry decodes past its declared size: README.txt"
+        extract -q ${TEST_DATA}/TestArchive1-Overrun.Z ${WORK_DIR})
+    run_fails("compression ratio limit"
+        extract -q --max-ratio 1 ${TEST_DATA}/TestArchive1-HighCompression.Z ${WORK_DIR})
+    # Limits that are not reached do not get in the way.
+    file(MAKE_DIRECTORY ${WORK_DIR}/ok)
+    run(extract -q --max-ratio 1 --max-entry-size 1 --max-total 1
+        ${TEST_DATA}/TestArchive1-NoCompression.Z ${WORK_DIR}/ok)
+    expect_extracted(${WORK_DIR}/ok)
+else()
+    message(FATAL_ERROR "unknown test case: ${CASE}")
+endif()
@@ -0,0 +1,155 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Test of ArchiveExecutor, run by ctest as
+//   executor_test <test-data directory>
+#include "ArchiveExecutor.h"
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+            failures++; \
+        } \
+    } while (0)
+
+static std::string message(std::exception_ptr error) {
+    try {
+        std::rethrow_exception(error);
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+}
+
+static void test(const fs::path& data) {
+    const char* levels[] = {"No", "Fast", "Medium", "High"};
+    const char* entries[] = {"README.txt", "Images\\Apache-icon.png", "Text\\APACHE-LICENSE-2.0.txt"};
+    ArchiveExecutor executor(2);
+
+    // Open every level and decompress its entries from the open handler.
+    std::mutex lock;
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> results;
+    std::vector<std::string> errors;
+    for (const char* level : levels) {
+        fs::path apath = data / (std::string("TestArchive1-") + level + "Compression.Z");
+        executor.open(apath, [&, level](ArchiveExecutor::Archive archive, std::exception_ptr error) {
+            if (error) {
+                std::lock_guard<std::mutex> guard(lock);
+                errors.push_back(message(error));
+                return;
+            }
+            for (const char* entry : entries) {
+                executor.decompress(archive, entry, [&, level, entry](std::vector<uint8_t> contents,
+                        std::exception_ptr error) {
+                    std::lock_guard<std::mutex> guard(lock);
+                    if (error) {
+                        errors.push_back(message(error));
+                    } else {
+                        results[level][entry] = std::move(contents);
+                    }
+                });
+            }
+        });
+    }
+    executor.wait();
+    CHECK(executor.pending() == 0);
+    CHECK(errors.empty());
+    const auto& expected = results["No"];
+    CHECK(expected.size() == 3);
+    CHECK(expected.at("README.txt").size() == 407);
+    CHECK(memcmp(expected.at("README.txt").data(), "This is a simple", 16) == 0);
+    CHECK(expected.at("Images\\Apache-icon.png").size() == 11864);
+    for (const char* level : levels) {
+        CHECK(results[level] == expected);
+    }
+
+    // Failures are passed to the handler.
+    std::string open_error;
+    executor.open(data / "no-such-archive.Z", [&](ArchiveExecutor::Archive archive, std::exception_ptr error) {
+        CHECK(!archive);
+        open_error = error ? message(error) : "";
+    });
+    ArchiveExecutor::Archive archive;
+    executor.open(data / "TestArchive1-HighCompression.Z", [&](ArchiveExecutor::Archive a, std::exception_ptr) {
+        archive = a;
+    });
+    executor.wait();
+    CHECK(!open_error.empty());
+    CHECK(archive);
+    std::string decompress_error;
+    executor.decompress(archive, "no-such-entry", [&](std::vector<uint8_t>, std::exception_ptr error) {
+        decompress_error = error ? message(error) : "";
+    });
+    executor.wait();
+    CHECK(decompress_error == "decompress() called with invalid path: no-such-entry");
+
+    // An exception escaping a handler is rethrown by wait(), and the workers
+    // keep serving requests.
+    for (int i = 0; i < 4; i++) {
+        executor.decompress(archive, archive->files()[0], [](std::vector<uint8_t>, std::exception_ptr) {
+            throw std::runtime_error("handler failed");
+        });
+    }
+    std::string rethrown;
+    try {
+        executor.wait();
+    } catch (const std::exception& e) {
+        rethrown = e.what();
+    }
+    CHECK(rethrown == "handler failed");
+    CHECK(executor.pending() == 0);
+    size_t completed = 0;
+    for (int i = 0; i < 8; i++) {
+        executor.decompress(archive, archive->files()[1], [&](std::vector<uint8_t> contents, std::exception_ptr error) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (!error && contents.size() == 11864) {
+                completed++;
+            }
+        });
+    }
+    executor.wait();
+    CHECK(completed == 8);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::cerr << "usage: executor_test TEST-DATA-DIR" << std::endl;
+        return 2;
+    }
+    try {
+        test(argv[1]);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        failures++;
+    }
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,276 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Test of `unshieldv3 serve`, run by ctest as
+//   server_test <unshieldv3 binary> <test-data directory>
+//
+// Starts the server on a socket in the temporary directory, talks to it as a
+// client and terminates it.
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #cond << std::endl; \
+            failures++; \
+        } \
+    } while (0)
+
+// Client side of one connection, buffering what the server sent.
+class Client {
+public:
+    explicit Client(const fs::path& socket_path) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        std::string sp = socket_path.string();
+        memcpy(addr.sun_path, sp.c_str(), sp.size() + 1);
+        // The server may still be starting.
+        for (int attempt = 0; attempt < 100; attempt++) {
+            m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+            if (connect(m_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+                return;
+            }
+            close(m_fd);
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        throw std::runtime_error("Cannot connect to " + sp);
+    }
+    ~Client() {
+        close(m_fd);
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    void send(const std::string& data) {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            ssize_t n = ::send(m_fd, data.data() + pos, data.size() - pos, MSG_NOSIGNAL);
+            if (n < 0) {
+                throw std::runtime_error(std::string("send: ") + strerror(errno));
+            }
+            pos += size_t(n);
+        }
+    }
+
+    void shutdownWrite() {
+        shutdown(m_fd, SHUT_WR);
+    }
+
+    // Read one response. Returns the status line without its newline; the
+    // payload of an "OK <size>" response goes to `body`.
+    std::string response(std::string& body) {
+        size_t eol;
+        while ((eol = m_buffer.find('\n')) == std::string::npos) {
+            if (!fill()) {
+                return "";
+            }
+        }
+        std::string status = m_buffer.substr(0, eol);
+        m_buffer.erase(0, eol + 1);
+        body.clear();
+        if (status.rfind("OK ", 0) == 0) {
+            size_t size = std::stoul(status.substr(3));
+            while (m_buffer.size() < size) {
+                if (!fill()) {
+                    throw std::runtime_error("Connection closed within a response");
+                }
+            }
+            body = m_buffer.substr(0, size);
+            m_buffer.erase(0, size);
+        }
+        return status;
+    }
+
+    std::string request(const std::string& line, std::string& body) {
+        send(line + "\n");
+        return response(body);
+    }
+
+    // True once the server has closed the connection.
+    bool closed() {
+        return m_buffer.empty() && !fill();
+    }
+
+private:
+    bool fill() {
+        char chunk[4096];
+        ssize_t n;
+        do {
+            n = recv(m_fd, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            return false;
+        }
+        m_buffer.append(chunk, size_t(n));
+        return true;
+    }
+
+    int m_fd = -1;
+    std::string m_buffer;
+};
+
+static std::string readRange(const fs::path& path, size_t offset, size_t length) {
+    std::ifstream in(path, std::ios::binary);
+    in.seekg(std::streamoff(offset));
+    std::string data(length, '\0');
+    in.read(&data[0], std::streamsize(length));
+    return data;
+}
+
+static std::string statsValue(const std::string& stats, const std::string& key) {
+    std::istringstream is(stats);
+    std::string k, v;
+    while (is >> k >> v) {
+        if (k == key) {
+            return v;
+        }
+    }
+    return "";
+}
+
+static void test(const fs::path& data, const fs::path& socket_path) {
+    // Entries of TestArchive1-NoCompression.Z are stored as is; their
+    // offsets and sizes are in its TOC.
+    fs::path plain = data / "TestArchive1-NoCompression.Z";
+    const struct {
+        const char* path;
+        size_t offset;
+        size_t size;
+    } entries[] = {
+        {"README.txt", 255, 407},
+        {"Images\\Apache-icon.png", 662, 11864},
+        {"Text\\APACHE-LICENSE-2.0.txt", 12526, 11358},
+    };
+
+    Client client(socket_path);
+    std::string body;
+    CHECK(client.request("LIST " + plain.string(), body).rfind("OK ", 0) == 0);
+    CHECK(body.rfind("README.txt\t407\t", 0) == 0);
+    CHECK(std::count(body.begin(), body.end(), '\n') == 3);
+
+    // Twice, so that the second round is served from the cache.
+    for (int round = 0; round < 2; round++) {
+        for (const char* level : {"No", "Fast", "Medium", "High"}) {
+            fs::path archive = data / (std::string("TestArchive1-") + level + "Compression.Z");
+            for (const auto& e : entries) {
+                std::string status = client.request("GET " + archive.string() + "\t" + e.path, body);
+                CHECK(status == "OK " + std::to_string(e.size));
+                CHECK(body == readRange(plain, e.offset, e.size));
+            }
+        }
+    }
+    CHECK(client.request("STATS", body).rfind("OK ", 0) == 0);
+    CHECK(statsValue(body, "requests") == "26");
+    CHECK(statsValue(body, "entries_hits") == "12");
+    CHECK(statsValue(body, "entries_misses") == "12");
+
+    // Errors leave the connection usable.
+    CHECK(client.request("GET " + plain.string() + "\tno-such-entry", body)
+            == "ERR no such entry: no-such-entry");
+    CHECK(client.request("GET " + plain.string(), body).rfind("ERR usage:", 0) == 0);
+    CHECK(client.request("GET " + (data / "no-such-archive.Z").string() + "\tREADME.txt", body)
+            .rfind("ERR ", 0) == 0);
+    CHECK(client.request("FROB", body) == "ERR unknown request");
+
+    // Pipelined requests are answered in order.
+    std::string readme = "GET " + plain.string() + "\tREADME.txt\n";
+    client.send(readme + "STATS\n" + readme);
+    CHECK(client.response(body) == "OK 407");
+    CHECK(client.response(body).rfind("OK ", 0) == 0 && body.rfind("requests ", 0) == 0);
+    CHECK(client.response(body) == "OK 407");
+
+    // An idle connection does not hold up others.
+    Client other(socket_path);
+    CHECK(other.request("GET " + plain.string() + "\tREADME.txt", body) == "OK 407");
+
+    // Requests sent before the client shuts down its side are answered.
+    other.send(readme + readme);
+    other.shutdownWrite();
+    CHECK(other.response(body) == "OK 407");
+    CHECK(other.response(body) == "OK 407");
+    CHECK(other.closed());
+
+    // An overlong request line is refused and the connection closed.
+    Client flood(socket_path);
+    flood.send(std::string(70 * 1024, 'x'));
+    CHECK(flood.response(body) == "ERR request too long");
+    CHECK(flood.closed());
+
+    // The first connection still works.
+    CHECK(client.request("GET " + plain.string() + "\tREADME.txt", body) == "OK 407");
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        std::cerr << "usage: server_test UNSHIELDV3 TEST-DATA-DIR" << std::endl;
+        return 2;
+    }
+    fs::path socket_path = fs::temp_directory_path()
+        / ("unshieldv3-test-" + std::to_string(getpid()) + ".sock");
+
+    pid_t server = fork();
+    if (server < 0) {
+        std::cerr << "fork: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    if (server == 0) {
+        execl(argv[1], argv[1], "serve", "-j", "2", "--cache", "1", socket_path.c_str(), nullptr);
+        std::cerr << "exec " << argv[1] << ": " << strerror(errno) << std::endl;
+        _exit(127);
+    }
+
+    try {
+        test(argv[2], socket_path);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        failures++;
+    }
+
+    // The server runs until it is terminated; anything else is a crash.
+    int status = 0;
+    if (waitpid(server, &status, WNOHANG) != 0) {
+        std::cerr << "server exited early" << std::endl;
+        failures++;
+    } else {
+        kill(server, SIGTERM);
+        waitpid(server, &status, 0);
+    }
+    fs::remove(socket_path);
+    if (failures) {
+        std::cerr << failures << " checks failed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,215 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "unshieldv3.h"
+#include "config.h"
+#include "ISArchiveV3.h"
+#include "MappedFile.h"
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+
+// Message of the last failed call on this thread. Kept per thread, like
+// errno, so that the pointer unshieldv3_error() returns cannot be freed by a
+// failure on another thread.
+static thread_local std::string t_error;
+
+struct unshieldv3_archive {
+    std::unique_ptr<ISArchiveV3> archive;
+
+    int fail(int code, const char* message) {
+        t_error = message;
+        return code;
+    }
+};
+
+namespace {
+
+int open(const std::function<std::shared_ptr<const MappedFile>()>& map,
+        uint64_t base_offset, unshieldv3_archive** archive)
+{
+    if (archive == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    *archive = new (std::nothrow) unshieldv3_archive;
+    if (*archive == nullptr) {
+        return UNSHIELDV3_E_IO;
+    }
+    std::shared_ptr<const MappedFile> file;
+    try {
+        file = map();
+    } catch (const std::exception& e) {
+        return (*archive)->fail(UNSHIELDV3_E_IO, e.what());
+    }
+    try {
+        (*archive)->archive = std::make_unique<ISArchiveV3>(file, base_offset);
+    } catch (const std::exception& e) {
+        return (*archive)->fail(UNSHIELDV3_E_FORMAT, e.what());
+    }
+    return UNSHIELDV3_OK;
+}
+
+// Convert exceptions from decoding into error codes.
+template<class F> int guarded(unshieldv3_archive* archive, size_t index, F f) {
+    if (archive == nullptr || !archive->archive) {
+        return UNSHIELDV3_E_ARG;
+    }
+    if (index >= archive->archive->files().size()) {
+        return archive->fail(UNSHIELDV3_E_NOT_FOUND, "Entry index out of range");
+    }
+    try {
+        return f(archive->archive->files()[index]);
+    } catch (const std::exception& e) {
+        bool aborted = strcmp(e.what(), "Output aborted") == 0;
+        return archive->fail(aborted ? UNSHIELDV3_E_ABORTED : UNSHIELDV3_E_DECODE, e.what());
+    }
+}
+
+} // namespace
+
+const char *unshieldv3_version(void) {
+    return CMAKE_PROJECT_VER;
+}
+
+int unshieldv3_open_path(const char *path, uint64_t base_offset, unshieldv3_archive **archive) {
+    if (path == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    return open([path]() {
+        return std::make_shared<const MappedFile>(path);
+    }, base_offset, archive);
+}
+
+int unshieldv3_open_fd(int fd, uint64_t base_offset, unshieldv3_archive **archive) {
+#ifndef _WIN32
+    return open([fd]() {
+        return std::make_shared<const MappedFile>(fd);
+    }, base_offset, archive);
+#else
+    (void)fd;
+    (void)base_offset;
+    (void)archive;
+    return UNSHIELDV3_E_IO;
+#endif
+}
+
+int unshieldv3_open_memory(const void *data, size_t size, unshieldv3_archive **archive) {
+    if (data == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    return open([data, size]() {
+        return std::make_shared<const MappedFile>(static_cast<const uint8_t*>(data), size);
+    }, 0, archive);
+}
+
+void unshieldv3_close(unshieldv3_archive *archive) {
+    delete archive;
+}
+
+const char *unshieldv3_error(const unshieldv3_archive *archive) {
+    if (archive == nullptr) {
+        return "Invalid archive handle";
+    }
+    return t_error.c_str();
+}
+
+size_t unshieldv3_entry_count(const unshieldv3_archive *archive) {
+    if (archive == nullptr || !archive->archive) {
+        return 0;
+    }
+    return archive->archive->files().size();
+}
+
+int unshieldv3_entry_at(const unshieldv3_archive *archive, size_t index, unshieldv3_entry *entry) {
+    if (archive == nullptr || !archive->archive || entry == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    const auto& files = archive->archive->files();
+    if (index >= files.size()) {
+        return UNSHIELDV3_E_NOT_FOUND;
+    }
+    const auto& f = files[index];
+    entry->path = f.fullPath().data();
+    entry->name = entry->path + (f.fullPath().size() - f.name().size());
+    entry->compressed_size = f.compressed_size;
+    entry->uncompressed_size = f.uncompressed_size;
+    entry->datetime = f.datetime;
+    entry->attrib = f.attrib;
+    return UNSHIELDV3_OK;
+}
+
+int unshieldv3_find(const unshieldv3_archive *archive, const char *path, size_t *index) {
+    if (archive == nullptr || !archive->archive || path == nullptr || index == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    const ISArchiveV3::File* f = archive->archive->file(path);
+    if (f == nullptr) {
+        return UNSHIELDV3_E_NOT_FOUND;
+    }
+    *index = size_t(f - archive->archive->files().data());
+    return UNSHIELDV3_OK;
+}
+
+int unshieldv3_decompress(unshieldv3_archive *archive, size_t index,
+                          void *buf, size_t size, size_t *written)
+{
+    return guarded(archive, index, [&](const ISArchiveV3::File& f) {
+        if (written) {
+            *written = f.uncompressed_size;
+        }
+        if (size < f.uncompressed_size || (buf == nullptr && f.uncompressed_size)) {
+            return archive->fail(UNSHIELDV3_E_BUFFER, "Output buffer too small");
+        }
+        uint8_t* out = static_cast<uint8_t*>(buf);
+        size_t pos = 0;
+        bool overflow = false;
+        try {
+            archive->archive->decompress(f, [&](const uint8_t* data, size_t len) {
+                if (len > size - pos) {
+                    overflow = true;
+                    return false;
+                }
+                memcpy(out + pos, data, len);
+                pos += len;
+                return true;
+            });
+        } catch (const std::exception&) {
+            if (!overflow) {
+                throw;
+            }
+        }
+        if (overflow || pos != f.uncompressed_size) {
+            return archive->fail(UNSHIELDV3_E_DECODE, "Entry size does not match the TOC");
+        }
+        return UNSHIELDV3_OK;
+    });
+}
+
+int unshieldv3_decompress_cb(unshieldv3_archive *archive, size_t index,
+                             unshieldv3_write_fn write, void *ctx)
+{
+    if (write == nullptr) {
+        return UNSHIELDV3_E_ARG;
+    }
+    return guarded(archive, index, [&](const ISArchiveV3::File& f) {
+        archive->archive->decompress(f, [&](const uint8_t* data, size_t len) {
+            return write(ctx, data, len) == 0;
+        });
+        return UNSHIELDV3_OK;
+    });
+}
@@ -0,0 +1,97 @@
+/* unshieldv3 -- extract InstallShield V3 archives.
+Copyright (c) 2025 Wolfgang Frisch <wfrisch@riseup.net>
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+/* C interface of libunshieldv3.
+ *
+ * An archive handle is not thread-safe in general, but entries of one handle
+ * may be decompressed concurrently: every open function maps the archive
+ * into memory and decodes from the mapping.
+ *
+ * All functions returning int return UNSHIELDV3_OK or a negative error code;
+ * unshieldv3_error() describes the last error on the calling thread.
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UNSHIELDV3_OK              0
+#define UNSHIELDV3_E_IO           -1  /* cannot open, map or read */
+#define UNSHIELDV3_E_FORMAT       -2  /* not a valid archive */
+#define UNSHIELDV3_E_NOT_FOUND    -3  /* no such entry */
+#define UNSHIELDV3_E_BUFFER       -4  /* output buffer too small */
+#define UNSHIELDV3_E_DECODE       -5  /* corrupt compressed data */
+#define UNSHIELDV3_E_ABORTED      -6  /* write callback returned non-zero */
+#define UNSHIELDV3_E_ARG          -7  /* invalid argument */
+
+/* attribute bits of unshieldv3_entry.attrib */
+#define UNSHIELDV3_ATTR_READONLY     0x01
+#define UNSHIELDV3_ATTR_HIDDEN       0x02
+#define UNSHIELDV3_ATTR_SYSTEM       0x04
+#define UNSHIELDV3_ATTR_UNCOMPRESSED 0x10
+#define UNSHIELDV3_ATTR_ARCHIVE      0x20
+
+typedef struct unshieldv3_archive unshieldv3_archive;
+
+typedef struct unshieldv3_entry {
+    const char *path;           /* full path, directory separator '\\' */
+    const char *name;           /* file name, points into path */
+    uint32_t compressed_size;
+    uint32_t uncompressed_size;
+    uint32_t datetime;          /* DOS date (low word) and time (high word) */
+    uint8_t attrib;
+} unshieldv3_entry;
+
+/* Receives consecutive pieces of an entry; return non-zero to abort. */
+typedef int (*unshieldv3_write_fn)(void *ctx, const void *data, size_t len);
+
+const char *unshieldv3_version(void);
+
+/* Open an archive at `base_offset` within a file, a file descriptor (not
+ * closed by the library) or a memory buffer (which must stay valid until
+ * unshieldv3_close()). On failure *archive may still be set so that
+ * unshieldv3_error() can be queried; it must be closed either way. */
+int unshieldv3_open_path(const char *path, uint64_t base_offset, unshieldv3_archive **archive);
+int unshieldv3_open_fd(int fd, uint64_t base_offset, unshieldv3_archive **archive);
+int unshieldv3_open_memory(const void *data, size_t size, unshieldv3_archive **archive);
+void unshieldv3_close(unshieldv3_archive *archive);
+
+/* Message of the last failed call on the calling thread, "" if there was
+ * none. It is kept per thread, like errno, and stays valid until the next
+ * failing call on the same thread. */
+const char *unshieldv3_error(const unshieldv3_archive *archive);
+
+size_t unshieldv3_entry_count(const unshieldv3_archive *archive);
+/* Strings in *entry stay valid until the archive is closed. */
+int unshieldv3_entry_at(const unshieldv3_archive *archive, size_t index, unshieldv3_entry *entry);
+int unshieldv3_find(const unshieldv3_archive *archive, const char *path, size_t *index);
+
+/* Decompress entry `index` into buf[0..size). *written receives the entry
+ * size; with UNSHIELDV3_E_BUFFER it is the size required. */
+int unshieldv3_decompress(unshieldv3_archive *archive, size_t index,
+                          void *buf, size_t size, size_t *written);
+/* Decompress entry `index` through `write`, at most 4096 bytes per call for
+ * compressed entries. */
+int unshieldv3_decompress_cb(unshieldv3_archive *archive, size_t index,
+                             unshieldv3_write_fn write, void *ctx);
+
+#ifdef __cplusplus
+}
+#endif